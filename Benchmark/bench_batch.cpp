@@ -0,0 +1,68 @@
+// 逐个 addTask 与按不同批大小 addTasks 的投递吞吐对比
+// g++ -std=c++20 -O2 -I.. bench_batch.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_batch
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+constexpr int TaskNum = 1000000;
+
+template<typename F>
+double measure(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// 超时说明有任务没有执行，直接退出而不是一直等待
+void waitAll(std::atomic<int>& cnt) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while(cnt.load() < TaskNum) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            fprintf(stderr, "timeout: %d of %d tasks done\n", cnt.load(), TaskNum);
+            std::exit(1);
+        }
+        std::this_thread::yield();
+    }
+    cnt = 0;
+}
+
+int main() {
+    ThreadPool* p = ThreadPool::getInstance();
+    unsigned int num = std::max(2u, std::thread::hardware_concurrency());
+    p->setThreadNum(num);
+    printf("threads %u, %d tasks\n", num, TaskNum);
+
+    std::atomic<int> cnt{0};
+    double ms = measure([&]() {
+        for(int i=0;i<TaskNum;++i) {
+            p->addTask([&cnt]() { ++cnt; });
+        }
+        waitAll(cnt);
+    });
+    printf("addTask        %8.1f ms  %6.1f ns/task\n", ms, ms * 1e6 / TaskNum);
+
+    for(int batch : {16, 256, 4096}) {
+        std::vector<Task> tasks;
+        tasks.reserve(batch);
+        ms = measure([&]() {
+            for(int i=0;i<TaskNum;i+=batch) {
+                int n = std::min(batch, TaskNum - i);
+                for(int j=0;j<n;++j) {
+                    tasks.emplace_back([&cnt]() { ++cnt; });
+                }
+                p->addTasks(tasks);
+                tasks.clear();
+            }
+            waitAll(cnt);
+        });
+        printf("addTasks %5d %8.1f ms  %6.1f ns/task\n", batch, ms, ms * 1e6 / TaskNum);
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// 分发线程空闲时从投递到订阅者被调用的延迟，按分发方式分别统计
+// g++ -std=c++20 -O2 -I.. bench_dispatch.cpp ../MessageQueue/messageQueue.cpp ../MessageQueue/journal.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_dispatch
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int RoundNum = 2000;
+
+struct Stamp {
+    Clock::time_point postTime;
+};
+
+void run(const char* name, MessageQueue::DispatchMode mode) {
+    MessageQueue* mq = MessageQueue::getInstance();
+    std::string topic = std::string("bench/dispatch/") + name;
+    mq->setDispatchMode(topic, mode);
+    std::atomic<long> ns{-1};
+    int id = mq->subscribe<Stamp>(topic, [&ns](const Stamp& s) {
+        ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s.postTime).count();
+    });
+    TopicID t = internTopic(topic);
+
+    std::vector<long> latency;
+    for(int i=0;i<RoundNum;++i) {
+        // 等分发线程重新进入休眠后再投递
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        ns = -1;
+        mq->post(t, Stamp{Clock::now()});
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while(ns.load() < 0) {
+            // 超时说明唤醒丢失，订阅者还引用着 ns，直接退出
+            if(Clock::now() > deadline) {
+                fprintf(stderr, "%s: message not delivered within 10 s\n", name);
+                std::exit(1);
+            }
+            std::this_thread::yield();
+        }
+        latency.push_back(ns.load());
+    }
+    mq->unregisterSubscripter(id);
+    std::sort(latency.begin(), latency.end());
+    printf("%-10s post -> handler p50 %7.1f us  p99 %7.1f us  max %8.1f us\n", name,
+           latency[RoundNum / 2] / 1000.0, latency[RoundNum * 99 / 100] / 1000.0, latency.back() / 1000.0);
+}
+
+int main() {
+    printf("%d rounds, idle 500us between posts\n", RoundNum);
+    run("Inline", MessageQueue::Inline);
+    run("Pooled", MessageQueue::Pooled);
+    run("Dedicated", MessageQueue::Dedicated);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// MpscQueue 与 mutex + std::queue 在多生产者下的吞吐对比，以及多线程 postMessage 的端到端吞吐
+// g++ -std=c++20 -O2 -I.. bench_mpsc.cpp ../MessageQueue/messageQueue.cpp ../MessageQueue/journal.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_mpsc
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "MessageQueue/mpscQueue.hpp"
+#include "MessageQueue/messageQueue.h"
+using namespace shochu;
+
+constexpr int ItemNum = 2000000;
+
+// 原来的实现方式：一把锁保护 std::queue
+template<typename T>
+class LockedQueue {
+public:
+    void push(T&& v) {
+        std::lock_guard<std::mutex> l(this->m);
+        this->q.push(std::move(v));
+    }
+    bool pop(T& out) {
+        std::lock_guard<std::mutex> l(this->m);
+        if(this->q.empty()) {
+            return false;
+        }
+        out = std::move(this->q.front());
+        this->q.pop();
+        return true;
+    }
+
+private:
+    std::mutex m;
+    std::queue<T> q;
+};
+
+template<typename F>
+double measure(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template<typename Queue>
+double run(int producerNum) {
+    Queue q;
+    return measure([&]() {
+        std::vector<std::thread> producers;
+        for(int p=0;p<producerNum;++p) {
+            producers.emplace_back([&q, producerNum]() {
+                for(int i=0;i<ItemNum/producerNum;++i) {
+                    q.push(int(i));
+                }
+            });
+        }
+        int total = ItemNum / producerNum * producerNum;
+        int v;
+        for(int n=0;n<total;) {
+            if(q.pop(v)) {
+                ++n;
+            }
+        }
+        for(auto& t : producers) {
+            t.join();
+        }
+    });
+}
+
+int main() {
+    printf("%d items\n", ItemNum);
+    for(int producerNum : {1, 2, 4, 8}) {
+        double locked = run<LockedQueue<int>>(producerNum);
+        double mpsc = run<MpscQueue<int>>(producerNum);
+        printf("producers %d   locked queue %7.1f ms   MpscQueue %7.1f ms   x%.2f\n",
+               producerNum, locked, mpsc, locked / mpsc);
+    }
+
+    // 投递到订阅者收到为止
+    MessageQueue* mq = MessageQueue::getInstance();
+    std::atomic<int> received{0};
+    mq->subscribe<int>("bench/mpsc", [&received](const int&) { ++received; });
+    TopicID topic = internTopic("bench/mpsc");
+    for(int producerNum : {1, 4}) {
+        received = 0;
+        int total = ItemNum / 4 / producerNum * producerNum;
+        double ms = measure([&]() {
+            std::vector<std::thread> producers;
+            for(int p=0;p<producerNum;++p) {
+                producers.emplace_back([mq, topic, total, producerNum]() {
+                    for(int i=0;i<total/producerNum;++i) {
+                        mq->post(topic, int(i));
+                    }
+                });
+            }
+            for(auto& t : producers) {
+                t.join();
+            }
+            // 超时说明有消息丢失，直接退出而不是一直等待
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+            while(received.load() < total) {
+                if(std::chrono::steady_clock::now() > deadline) {
+                    fprintf(stderr, "timeout: %d of %d messages received\n", received.load(), total);
+                    std::exit(1);
+                }
+                std::this_thread::yield();
+            }
+        });
+        printf("post producers %d   %d messages %7.1f ms   %6.1f ns/message\n", producerNum, total, ms, ms * 1e6 / total);
+    }
+    return 0;
+}
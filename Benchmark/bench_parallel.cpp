@@ -0,0 +1,70 @@
+// parallelFor / parallelTransformReduce / parallelSort / parallelScan 与串行版本的耗时对比
+// g++ -std=c++20 -O2 -I.. bench_parallel.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_parallel
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+
+#include "ThreadPool/parallel.hpp"
+using namespace shochu;
+
+constexpr size_t N = 1 << 24;
+
+template<typename F>
+double measure(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void print(const char* name, double serial, double parallel) {
+    printf("%-16s serial %8.1f ms   parallel %8.1f ms   x%.2f\n", name, serial, parallel, serial / parallel);
+}
+
+int main() {
+    ThreadPool* p = ThreadPool::getInstance();
+    printf("threads %u, %zu elements\n", p->getThreadNum(), N);
+
+    std::vector<double> v(N);
+    print("for", measure([&]() {
+        for(size_t i=0;i<N;++i) {
+            v[i] = std::sqrt(double(i));
+        }
+    }), measure([&]() {
+        parallelFor(size_t(0), N, [&v](size_t i) { v[i] = std::sqrt(double(i)); });
+    }));
+
+    double s1 = 0;
+    double s2 = 0;
+    print("transformReduce", measure([&]() {
+        s1 = std::transform_reduce(v.begin(), v.end(), 0.0, std::plus<>(), [](double x) { return x * x; });
+    }), measure([&]() {
+        s2 = parallelTransformReduce(v.begin(), v.end(), 0.0, std::plus<>(), [](double x) { return x * x; });
+    }));
+
+    std::vector<double> out(N);
+    print("scan", measure([&]() {
+        std::inclusive_scan(v.begin(), v.end(), out.begin());
+    }), measure([&]() {
+        parallelScan(v.begin(), v.end(), out.begin());
+    }));
+
+    std::mt19937 rng(1);
+    std::vector<unsigned int> a(N);
+    for(auto& x : a) {
+        x = rng();
+    }
+    std::vector<unsigned int> b = a;
+    print("sort", measure([&]() {
+        std::sort(a.begin(), a.end());
+    }), measure([&]() {
+        parallelSort(b.begin(), b.end());
+    }));
+    printf("check %d %d\n", std::abs(s1 - s2) < 1e-6 * s1, a == b);
+    return 0;
+}
@@ -0,0 +1,68 @@
+// 大量低优先级任务积压时，少量任务用同一优先级和 High 投递的排队延迟对比
+// g++ -std=c++20 -O2 -I.. bench_priority.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_priority
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int FloodNum = 200000;
+constexpr int ProbeNum = 200;
+
+void spin(std::chrono::nanoseconds d) {
+    auto end = Clock::now() + d;
+    while(Clock::now() < end) {
+    }
+}
+
+void run(const char* name, ThreadPool* p, ThreadPool::Priority probe) {
+    std::atomic<int> floodLeft{FloodNum};
+    for(int i=0;i<FloodNum;++i) {
+        p->addTask(ThreadPool::Low, [&floodLeft]() {
+            spin(std::chrono::microseconds(2));
+            --floodLeft;
+        });
+    }
+
+    std::vector<long> latency(ProbeNum, -1);
+    std::atomic<int> probeLeft{ProbeNum};
+    for(int i=0;i<ProbeNum;++i) {
+        auto postTime = Clock::now();
+        p->addTask(probe, [&latency, &probeLeft, i, postTime]() {
+            latency[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - postTime).count();
+            --probeLeft;
+        });
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(120);
+    while(probeLeft.load() || floodLeft.load()) {
+        // 超时说明有任务丢失，任务还引用着栈上的计数，直接退出
+        if(Clock::now() > deadline) {
+            fprintf(stderr, "%s: tasks not finished within 120 s\n", name);
+            std::exit(1);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::sort(latency.begin(), latency.end());
+    printf("%-10s probe latency p50 %9.1f us  p99 %9.1f us\n", name,
+           latency[ProbeNum / 2] / 1000.0, latency[ProbeNum * 99 / 100] / 1000.0);
+}
+
+int main() {
+    ThreadPool* p = ThreadPool::getInstance();
+    unsigned int num = std::max(2u, std::thread::hardware_concurrency());
+    p->setThreadNum(num);
+    // 关闭老化，只比较优先级本身
+    p->setAgingTime(std::chrono::hours(1));
+    printf("threads %u, %d low tasks of 2us, %d probes\n", num, FloodNum, ProbeNum);
+    run("Low", p, ThreadPool::Low);
+    run("High", p, ThreadPool::High);
+    return 0;
+}
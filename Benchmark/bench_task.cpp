@@ -0,0 +1,111 @@
+// Task 与 shared_ptr<ThreadPoolTask> + std::function 的构造/执行开销和每个任务的内存申请次数
+// g++ -std=c++20 -O2 -I.. bench_task.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_task
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+std::atomic<size_t> allocNum{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocNum.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+constexpr int TaskNum = 1000000;
+
+struct Result {
+    double ms;
+    double allocPerTask;
+};
+
+template<typename F>
+Result measure(F&& f) {
+    size_t before = allocNum.load();
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    return Result{ms, double(allocNum.load() - before) / TaskNum};
+}
+
+void print(const char* name, Result r) {
+    printf("%-34s %8.1f ms  %6.1f ns/task  %5.2f alloc/task\n", name, r.ms, r.ms * 1e6 / TaskNum, r.allocPerTask);
+}
+
+int main() {
+    // 只构造、移动、执行，不经过线程池
+    long sum = 0;
+    std::vector<std::shared_ptr<TaskInterface>> oldTasks;
+    oldTasks.reserve(TaskNum);
+    print("shared_ptr<ThreadPoolTask> local", measure([&]() {
+        for(int i=0;i<TaskNum;++i) {
+            std::shared_ptr<ThreadPoolTask<int>> t(new ThreadPoolTask<int>([&sum](int x) { sum += x; }));
+            t->data = std::make_tuple(i);
+            oldTasks.push_back(std::move(t));
+        }
+        for(auto& t : oldTasks) {
+            t->run();
+        }
+        oldTasks.clear();
+    }));
+
+    std::vector<Task> tasks;
+    tasks.reserve(TaskNum);
+    print("Task local", measure([&]() {
+        for(int i=0;i<TaskNum;++i) {
+            tasks.emplace_back([&sum](int x) { sum += x; }, i);
+        }
+        for(auto& t : tasks) {
+            t();
+        }
+        tasks.clear();
+    }));
+
+    // 经过线程池投递和执行
+    ThreadPool* p = ThreadPool::getInstance();
+    std::atomic<int> cnt{0};
+    // 超时说明有任务没有执行，直接退出而不是一直等待
+    auto waitAll = [&cnt]() {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while(cnt.load() < TaskNum) {
+            if(std::chrono::steady_clock::now() > deadline) {
+                fprintf(stderr, "timeout: %d of %d tasks done\n", cnt.load(), TaskNum);
+                std::exit(1);
+            }
+            std::this_thread::yield();
+        }
+        cnt = 0;
+    };
+    print("addTask(shared_ptr<ThreadPoolTask>)", measure([&]() {
+        for(int i=0;i<TaskNum;++i) {
+            std::shared_ptr<ThreadPoolTask<int>> t(new ThreadPoolTask<int>([&cnt](int) { ++cnt; }));
+            t->data = std::make_tuple(i);
+            p->addTask(t);
+        }
+        waitAll();
+    }));
+    print("addTask(f, args...)", measure([&]() {
+        for(int i=0;i<TaskNum;++i) {
+            p->addTask([&cnt](int) { ++cnt; }, i);
+        }
+        waitAll();
+    }));
+    printf("checksum %ld\n", sum);
+    return 0;
+}
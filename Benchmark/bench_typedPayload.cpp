@@ -0,0 +1,98 @@
+// Event + std::any、类型化 post 和环形通道投递同一负载的吞吐和每条消息的内存申请次数
+// g++ -std=c++20 -O2 -I.. bench_typedPayload.cpp ../MessageQueue/messageQueue.cpp ../MessageQueue/journal.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_typedPayload
+#include <new>
+#include <span>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+#include "MessageQueue/messageQueue.h"
+using namespace shochu;
+
+std::atomic<size_t> allocNum{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocNum.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+struct Sample {
+    uint64_t id;
+    double price;
+    double volume;
+};
+
+constexpr int MessageNum = 500000;
+
+template<typename F>
+void measure(const char* name, std::atomic<int>& received, F&& post) {
+    received = 0;
+    size_t before = allocNum.load();
+    auto begin = std::chrono::steady_clock::now();
+    for(int i=0;i<MessageNum;++i) {
+        post(i);
+    }
+    // 超时说明有消息丢失，直接退出而不是一直等待
+    auto deadline = begin + std::chrono::seconds(60);
+    while(received.load() < MessageNum) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            fprintf(stderr, "%s: timeout, %d of %d messages received\n", name, received.load(), MessageNum);
+            std::exit(1);
+        }
+        std::this_thread::yield();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    printf("%-18s %7.1f ms  %6.1f ns/message  %5.2f alloc/message\n", name, ms, ms * 1e6 / MessageNum,
+           double(allocNum.load() - before) / MessageNum);
+}
+
+int main() {
+    MessageQueue* mq = MessageQueue::getInstance();
+    std::atomic<int> received{0};
+    printf("%d messages, 1 subscriber\n", MessageNum);
+
+    // 原来的方式：字段放在 std::any 中
+    mq->registerSubscripter("bench/event", [&received](Event e) {
+        volatile double p = std::any_cast<double>(e["price"]);
+        (void)p;
+        ++received;
+    });
+    TopicID eventTopic = internTopic("bench/event");
+    measure("Event + std::any", received, [mq, eventTopic](int i) {
+        Event e(eventTopic);
+        e["id"] = uint64_t(i);
+        e["price"] = 1.5 * i;
+        e["volume"] = 2.0;
+        mq->postMessage(std::move(e));
+    });
+
+    mq->subscribe<Sample>("bench/typed", [&received](const Sample& s) {
+        volatile double p = s.price;
+        (void)p;
+        ++received;
+    });
+    TopicID typedTopic = internTopic("bench/typed");
+    measure("post<Sample>", received, [mq, typedTopic](int i) {
+        mq->post(typedTopic, Sample{uint64_t(i), 1.5 * i, 2.0});
+    });
+
+    Channel<Sample>& ch = mq->openChannel<Sample>("bench/channel", 1 << 16);
+    ch.subscribe([&received](std::span<const Sample> batch) {
+        received += int(batch.size());
+    });
+    measure("Channel<Sample>", received, [&ch](int i) {
+        ch.publish(Sample{uint64_t(i), 1.5 * i, 2.0});
+    });
+    return 0;
+}
@@ -0,0 +1,111 @@
+// 空闲线程池的唤醒延迟和空闲时的 CPU 占用，与每 50us 轮询一次的方式对比
+// g++ -std=c++20 -O2 -I.. bench_wakeup.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_wakeup
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <sys/resource.h>
+
+#include "ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 原来的实现方式：队列为空时休眠 50us 后再检查
+class PollingPool {
+public:
+    explicit PollingPool(unsigned int num) : isQuit(false) {
+        for(unsigned int i=0;i<num;++i) {
+            this->threads.emplace_back([this]() {
+                while(!this->isQuit) {
+                    std::unique_lock<std::mutex> l(this->m);
+                    if(this->q.empty()) {
+                        l.unlock();
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                        continue;
+                    }
+                    auto f = std::move(this->q.front());
+                    this->q.pop();
+                    l.unlock();
+                    f();
+                }
+            });
+        }
+    }
+    ~PollingPool() {
+        this->isQuit = true;
+        for(auto& t : this->threads) {
+            t.join();
+        }
+    }
+    void addTask(std::function<void()> f) {
+        std::lock_guard<std::mutex> l(this->m);
+        this->q.push(std::move(f));
+    }
+
+private:
+    std::mutex m;
+    std::queue<std::function<void()>> q;
+    std::vector<std::thread> threads;
+    std::atomic<bool> isQuit;
+};
+
+constexpr int RoundNum = 2000;
+
+long cpuUs() {
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1000000L + u.ru_utime.tv_usec + u.ru_stime.tv_usec;
+}
+
+template<typename Pool>
+void run(const char* name, Pool* p) {
+    // 每次等线程重新进入空闲后再投递
+    std::vector<long> latency;
+    for(int i=0;i<RoundNum;++i) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        std::atomic<long> ns{-1};
+        auto postTime = Clock::now();
+        p->addTask([&ns, postTime]() {
+            ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - postTime).count();
+        });
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while(ns.load() < 0) {
+            // 超时说明唤醒丢失，任务还引用着 ns，直接退出
+            if(Clock::now() > deadline) {
+                fprintf(stderr, "%s: task not run within 10 s\n", name);
+                std::exit(1);
+            }
+            std::this_thread::yield();
+        }
+        latency.push_back(ns.load());
+    }
+    std::sort(latency.begin(), latency.end());
+
+    long before = cpuUs();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    double idle = (cpuUs() - before) / 10000.0;
+    printf("%-16s wakeup p50 %7.1f us  p99 %7.1f us   idle cpu %5.1f %%\n", name,
+           latency[RoundNum / 2] / 1000.0, latency[RoundNum * 99 / 100] / 1000.0, idle);
+}
+
+int main() {
+    unsigned int num = std::max(2u, std::thread::hardware_concurrency());
+    printf("threads %u, %d rounds\n", num, RoundNum);
+    {
+        PollingPool p(num);
+        run("polling 50us", &p);
+    }
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(num);
+    run("ThreadPool", p);
+    p->setSpinNum(0);
+    run("ThreadPool spin0", p);
+    return 0;
+}
@@ -0,0 +1,127 @@
+// 工作窃取调度与单个加锁队列的对比：外部线程大量投递小任务、任务内部递归派生子任务
+// g++ -std=c++20 -O2 -I.. bench_workStealing.cpp ../ThreadPool/threadPool.cpp ../ThreadPool/timerWheel.cpp -pthread -o bench_workStealing
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <condition_variable>
+
+#include "ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+// 原来的实现方式：所有线程共用一个 std::queue 和一把锁
+class LockedPool {
+public:
+    explicit LockedPool(unsigned int num) : isQuit(false) {
+        for(unsigned int i=0;i<num;++i) {
+            this->threads.emplace_back([this]() {
+                while(true) {
+                    std::unique_lock<std::mutex> l(this->m);
+                    this->cv.wait(l, [this]() {
+                        return this->isQuit || !this->q.empty();
+                    });
+                    if(this->q.empty()) {
+                        return;
+                    }
+                    auto f = std::move(this->q.front());
+                    this->q.pop();
+                    l.unlock();
+                    f();
+                }
+            });
+        }
+    }
+    ~LockedPool() {
+        std::unique_lock<std::mutex> l(this->m);
+        this->isQuit = true;
+        l.unlock();
+        this->cv.notify_all();
+        for(auto& t : this->threads) {
+            t.join();
+        }
+    }
+    void addTask(std::function<void()> f) {
+        std::unique_lock<std::mutex> l(this->m);
+        this->q.push(std::move(f));
+        l.unlock();
+        this->cv.notify_one();
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> q;
+    std::vector<std::thread> threads;
+    bool isQuit;
+};
+
+constexpr int FloodNum = 1000000;
+constexpr int FanDepth = 18;
+
+template<typename F>
+double measure(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// 超时说明调度出了问题，直接退出而不是一直等待
+void waitFor(std::atomic<int>& cnt, int n) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while(cnt.load() < n) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            fprintf(stderr, "timeout: %d of %d tasks done\n", cnt.load(), n);
+            std::exit(1);
+        }
+        std::this_thread::yield();
+    }
+}
+
+template<typename Pool>
+void fanOut(Pool* p, std::atomic<int>& cnt, int depth) {
+    ++cnt;
+    if(depth == 0) {
+        return;
+    }
+    p->addTask([p, &cnt, depth]() { fanOut(p, cnt, depth - 1); });
+    p->addTask([p, &cnt, depth]() { fanOut(p, cnt, depth - 1); });
+}
+
+template<typename Pool>
+void run(const char* name, Pool* p) {
+    std::atomic<int> cnt{0};
+    double flood = measure([&]() {
+        for(int i=0;i<FloodNum;++i) {
+            p->addTask([&cnt]() { ++cnt; });
+        }
+        waitFor(cnt, FloodNum);
+    });
+
+    cnt = 0;
+    int total = (1 << (FanDepth + 1)) - 1;
+    double fan = measure([&]() {
+        p->addTask([p, &cnt]() { fanOut(p, cnt, FanDepth); });
+        waitFor(cnt, total);
+    });
+    printf("%-12s flood %8.1f ms (%6.1f Mtask/s)   fan-out %8.1f ms (%6.1f Mtask/s)\n",
+           name, flood, FloodNum / flood / 1000, fan, total / fan / 1000);
+}
+
+int main() {
+    unsigned int num = std::max(2u, std::thread::hardware_concurrency());
+    printf("threads %u, flood %d tasks, fan-out %d tasks\n", num, FloodNum, (1 << (FanDepth + 1)) - 1);
+    {
+        LockedPool p(num);
+        run("locked queue", &p);
+    }
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(num);
+    run("ThreadPool", p);
+    printf("stolen %zu\n", p->snapshot().stolenNum);
+    return 0;
+}
@@ -0,0 +1,229 @@
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include <bit>
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+
+/**
+ * @brief 预分配环形缓冲区上的多生产者多消费者通道
+ * 生产者用原子加法申领序号后写入对应槽位再发布，每个订阅者有自己的游标和线程，
+ * 每次把已发布的连续一段交给 handler，所有订阅者都看到全部消息
+ * @code {.cpp}
+ * auto& ch = MessageQueue::getInstance()->openChannel<Sample>("telemetry", 1 << 16);
+ * ch.subscribe([](std::span<const Sample> batch) { ... });
+ * ch.publish(Sample{...});
+ * @endcode
+ * @note 订阅者处理较慢时，生产者在最慢的订阅者腾出槽位之前自旋等待
+ * @note subscribe 可以在任意时刻调用，订阅者从订阅时尚未申领的第一条消息开始接收，
+ *       每个通道最多 MaxConsumerNum 个订阅者
+ */
+namespace shochu {
+
+class ChannelBase {
+public:
+    virtual ~ChannelBase() {}
+};
+
+template<typename T>
+requires std::is_default_constructible_v<T> && std::is_move_assignable_v<T>
+class Channel : public ChannelBase {
+public:
+    // capacity 向上取到2的幂
+    explicit Channel(size_t capacity) :
+        cap(std::bit_ceil(std::max<size_t>(capacity, 2))),
+        slots(new T[cap]),
+        published(new std::atomic<int64_t>[cap]),
+        consumerNum(0),
+        claimSeq(0),
+        minCursor(-1),
+        wakeSeq(0),
+        waitingNum(0),
+        isQuit(false) {
+        for(size_t i=0;i<this->cap;++i) {
+            this->published[i].store(-1, std::memory_order_relaxed);
+        }
+    }
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+    // 订阅者处理完已发布的消息后退出
+    ~Channel() override {
+        this->isQuit = true;
+        this->wakeSeq.fetch_add(1);
+        this->wakeSeq.notify_all();
+        size_t num = this->consumerNum.load();
+        for(size_t i=0;i<num;++i) {
+            this->consumers[i]->th.join();
+        }
+    }
+
+    static constexpr size_t MaxConsumerNum = 64;
+
+    size_t capacity() const {
+        return this->cap;
+    }
+
+    // 超过 MaxConsumerNum 个订阅者时抛出 std::length_error
+    template<typename F>
+    requires std::invocable<F&, std::span<const T>>
+    void subscribe(F&& handler) {
+        std::lock_guard<std::mutex> l(this->subMutex);
+        size_t num = this->consumerNum.load(std::memory_order_relaxed);
+        if(num == MaxConsumerNum) {
+            throw std::length_error("too many channel consumers");
+        }
+        // 游标为 -1 时先挡住绕圈的生产者，确定起点后再放开
+        auto c = std::make_unique<Consumer>();
+        c->handler = std::forward<F>(handler);
+        Consumer* p = c.get();
+        this->consumers[num] = std::move(c);
+        this->consumerNum.store(num + 1);
+        // 与生产者的 fetch_add 处于同一修改顺序：之后申领的生产者一定能看到该订阅者，
+        // 之前申领的序号小于起点，与该订阅者无关
+        int64_t start = this->claimSeq.fetch_add(0);
+        p->cursor.store(start - 1);
+        // 之前算出的缓存可能没有包含该订阅者，让生产者重新计算
+        this->minCursor.store(-1);
+        p->th = std::thread(&Channel::consume, this, p);
+    }
+
+    template<typename V>
+    void publish(V&& v) {
+        int64_t seq = this->claim(1);
+        this->slots[seq & (this->cap - 1)] = std::forward<V>(v);
+        this->published[seq & (this->cap - 1)].store(seq, std::memory_order_release);
+        this->wakeUp();
+    }
+
+    // 按不超过容量的段申领序号，每段只唤醒一次订阅者
+    template<typename It>
+    void publish(It first, It last) {
+        int64_t n = std::distance(first, last);
+        while(n > 0) {
+            int64_t k = std::min<int64_t>(n, this->cap);
+            int64_t seq = this->claim(k);
+            for(int64_t i=0;i<k;++i, ++first) {
+                this->slots[(seq + i) & (this->cap - 1)] = *first;
+            }
+            for(int64_t i=0;i<k;++i) {
+                this->published[(seq + i) & (this->cap - 1)].store(seq + i, std::memory_order_release);
+            }
+            // 下一段申领时要等订阅者腾出槽位，休眠的订阅者必须先被唤醒
+            this->wakeUp();
+            n -= k;
+        }
+    }
+
+private:
+    struct alignas(64) Consumer {
+        // 已处理的最后一个序号
+        std::atomic<int64_t> cursor{-1};
+        std::function<void(std::span<const T>)> handler;
+        std::thread th;
+    };
+
+    const size_t cap;
+    std::unique_ptr<T[]> slots;
+    // 槽位中已发布的序号，用于判断多个生产者写入的槽位是否都已就绪
+    std::unique_ptr<std::atomic<int64_t>[]> published;
+    // 前 consumerNum 个有效，加入后不再移动，生产者不加锁遍历
+    std::unique_ptr<Consumer> consumers[MaxConsumerNum];
+    std::atomic<size_t> consumerNum;
+    std::mutex subMutex;
+
+    alignas(64) std::atomic<int64_t> claimSeq;
+    // 最慢订阅者游标的缓存，只在可能覆盖未读槽位时才重新计算
+    alignas(64) std::atomic<int64_t> minCursor;
+    alignas(64) std::atomic<uint32_t> wakeSeq;
+    std::atomic<uint32_t> waitingNum;
+    std::atomic<bool> isQuit;
+
+    int64_t claim(int64_t n) {
+        int64_t seq = this->claimSeq.fetch_add(n);
+        int64_t wrap = seq + n - 1 - static_cast<int64_t>(this->cap);
+        if(wrap > this->minCursor.load(std::memory_order_acquire)) {
+            while(true) {
+                size_t num = this->consumerNum.load();
+                int64_t m = INT64_MAX;
+                for(size_t i=0;i<num;++i) {
+                    m = std::min(m, this->consumers[i]->cursor.load(std::memory_order_acquire));
+                }
+                this->minCursor.store(m);
+                // 计算期间有订阅者加入时，写入的缓存可能没有包含它，重新计算
+                if(this->consumerNum.load() != num) {
+                    continue;
+                }
+                if(wrap <= m) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        return seq;
+    }
+
+    void wakeUp() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(this->waitingNum.load(std::memory_order_relaxed)) {
+            this->wakeSeq.fetch_add(1, std::memory_order_release);
+            this->wakeSeq.notify_all();
+        }
+    }
+
+    void consume(Consumer* c) {
+        constexpr int SpinNum = 64;
+        int64_t next = c->cursor.load(std::memory_order_relaxed) + 1;
+        int spin = 0;
+        while(true) {
+            int64_t last = next - 1;
+            while(last + 1 - next < static_cast<int64_t>(this->cap)
+                  && this->published[(last + 1) & (this->cap - 1)].load(std::memory_order_acquire) == last + 1) {
+                ++last;
+            }
+            if(last >= next) {
+                // 跨过环尾时分两段交给 handler
+                size_t b = next & (this->cap - 1);
+                size_t n = last - next + 1;
+                size_t k = std::min(n, this->cap - b);
+                c->handler(std::span<const T>(this->slots.get() + b, k));
+                if(k < n) {
+                    c->handler(std::span<const T>(this->slots.get(), n - k));
+                }
+                c->cursor.store(last, std::memory_order_release);
+                next = last + 1;
+                spin = 0;
+                continue;
+            }
+            if(this->isQuit) {
+                break;
+            }
+            if(spin < SpinNum) {
+                ++spin;
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint32_t seq = this->wakeSeq.load(std::memory_order_acquire);
+            this->waitingNum.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(this->published[next & (this->cap - 1)].load(std::memory_order_acquire) != next && !this->isQuit) {
+                this->wakeSeq.wait(seq, std::memory_order_acquire);
+            }
+            this->waitingNum.fetch_sub(1);
+        }
+    }
+};
+
+}
+
+#endif // _CHANNEL_H_
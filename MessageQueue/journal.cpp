@@ -0,0 +1,418 @@
+#include "journal.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+std::system_error lastError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 新建的文件要把目录也刷盘，否则崩溃后文件项可能丢失
+void syncDir(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// 只读映射一个段，析构时解除映射
+class SegmentView {
+public:
+    SegmentView(const std::string& path, size_t size) : size(size), base(nullptr) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw lastError(path);
+        }
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) {
+            throw lastError(path);
+        }
+        this->base = static_cast<const char*>(p);
+    }
+    SegmentView(const SegmentView&) = delete;
+    SegmentView& operator=(const SegmentView&) = delete;
+    ~SegmentView() {
+        ::munmap(const_cast<char*>(this->base), this->size);
+    }
+
+    const char* data() const {
+        return this->base;
+    }
+
+private:
+    size_t size;
+    const char* base;
+};
+
+}
+
+shochu::Journal::Journal(const JournalOption& option, const void* type, size_t payloadSize) :
+    option(option),
+    type_(type),
+    payloadSize(payloadSize),
+    recordSize((sizeof(Header) + payloadSize + 7) / 8 * 8),
+    recordNum(option.segmentSize / recordSize),
+    writeOff(0),
+    seq(0),
+    committed(0),
+    writtenOff(0),
+    error(0),
+    syncedOff(0),
+    fullSyncedOff(0),
+    isDirDirty(false),
+    isQuit(false) {
+    if(this->recordNum == 0) {
+        throw std::invalid_argument("journal segment size is smaller than one record");
+    }
+    std::filesystem::create_directories(this->option.dir);
+
+    for(auto& e : std::filesystem::directory_iterator(this->option.dir)) {
+        std::string stem = e.path().stem().string();
+        if(e.path().extension() == ".log" && !stem.empty()
+           && std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            this->segments.push_back(std::stoull(stem));
+        }
+    }
+    std::sort(this->segments.begin(), this->segments.end());
+
+    std::lock_guard<std::mutex> l(this->m);
+    if(this->segments.empty()) {
+        this->openSegment(0, true);
+    }
+    else {
+        this->openSegment(this->segments.back(), false);
+        try {
+            this->recover();
+        }
+        catch(...) {
+            this->closeSegment();
+            throw;
+        }
+    }
+    this->th = std::thread(&Journal::syncThread, this);
+}
+
+shochu::Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> l(this->m);
+        this->isQuit = true;
+    }
+    this->cv.notify_one();
+    this->th.join();
+
+    std::lock_guard<std::mutex> l(this->m);
+    this->closeFull();
+    this->closeSegment();
+    if(this->next.base) {
+        this->unmapSegment(this->next);
+        ::unlink(this->nextPath().c_str());
+    }
+    if(this->isDirDirty) {
+        syncDir(this->option.dir);
+    }
+}
+
+uint64_t shochu::Journal::append(const void* p) {
+    if(this->error.load(std::memory_order_relaxed)) {
+        return UINT64_MAX;
+    }
+    if(this->seq - this->cur.firstSeq == this->recordNum && !this->rollover()) {
+        return UINT64_MAX;
+    }
+
+    // 先写负载再算校验和，恢复时以校验和判断记录是否完整写入
+    char* r = this->cur.base + this->writeOff;
+    Header* h = reinterpret_cast<Header*>(r);
+    h->size = static_cast<uint32_t>(this->payloadSize);
+    h->seq = this->seq;
+    h->time = nowNs();
+    std::memcpy(r + sizeof(Header), p, this->payloadSize);
+    h->check = this->checksum(h, r + sizeof(Header));
+
+    this->writeOff += this->recordSize;
+    ++this->seq;
+    this->writtenOff.store(this->writeOff, std::memory_order_release);
+    this->committed.store(this->seq, std::memory_order_release);
+    return this->seq - 1;
+}
+
+bool shochu::Journal::rollover() {
+    std::lock_guard<std::mutex> l(this->m);
+    // 上一次切换的段还没有关闭，只在一个同步间隔内写满一整段时发生
+    this->closeFull();
+    std::string path = this->segmentPath(this->seq);
+    try {
+        if(this->next.base) {
+            if(::rename(this->nextPath().c_str(), path.c_str()) != 0) {
+                throw lastError(path);
+            }
+        }
+        else {
+            // 后台线程还没有准备好下一段
+            this->next = this->mapSegment(path, true);
+        }
+    }
+    catch(const std::system_error& e) {
+        this->error.store(e.code().value());
+        return false;
+    }
+
+    this->full = this->cur;
+    this->fullSyncedOff = this->syncedOff;
+    this->cur = this->next;
+    this->cur.firstSeq = this->seq;
+    this->next = Segment();
+    this->segments.push_back(this->seq);
+    this->isDirDirty = true;
+    this->writeOff = 0;
+    this->writtenOff.store(0, std::memory_order_relaxed);
+    this->syncedOff = 0;
+    this->cv.notify_one();
+    return true;
+}
+
+uint64_t shochu::Journal::replay(uint64_t from, const std::function<void(uint64_t, int64_t, const void*)>& f) const {
+    return this->scan(from, INT64_MIN, f);
+}
+
+uint64_t shochu::Journal::replaySince(std::chrono::system_clock::time_point t, const std::function<void(uint64_t, int64_t, const void*)>& f) const {
+    int64_t minTime = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    std::vector<uint64_t> segs;
+    {
+        std::lock_guard<std::mutex> l(this->m);
+        segs = this->segments;
+    }
+    // 从第一条记录早于 t 的最后一段开始扫描
+    uint64_t from = segs.front();
+    for(size_t i=1;i<segs.size();++i) {
+        Header h;
+        int fd = ::open(this->segmentPath(segs[i]).c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw lastError(this->segmentPath(segs[i]));
+        }
+        ssize_t n = ::pread(fd, &h, sizeof(h), 0);
+        ::close(fd);
+        if(n != sizeof(h) || h.seq != segs[i] || h.time >= minTime) {
+            break;
+        }
+        from = segs[i];
+    }
+    return this->scan(from, minTime, f);
+}
+
+uint64_t shochu::Journal::scan(uint64_t from, int64_t minTime, const std::function<void(uint64_t, int64_t, const void*)>& f) const {
+    if(int e = this->error.load()) {
+        throw std::system_error(e, std::generic_category(), this->option.dir);
+    }
+    // 只回放开始时已经追加的记录，之后追加的由调用者通过订阅接收
+    uint64_t end = this->committed.load(std::memory_order_acquire);
+    std::vector<uint64_t> segs;
+    {
+        std::lock_guard<std::mutex> l(this->m);
+        segs = this->segments;
+    }
+
+    uint64_t s = std::max(from, segs.front());
+    while(s < end) {
+        size_t i = std::upper_bound(segs.begin(), segs.end(), s) - segs.begin() - 1;
+        uint64_t segEnd = std::min(end, segs[i] + this->recordNum);
+        SegmentView view(this->segmentPath(segs[i]), this->option.segmentSize);
+        for(;s<segEnd;++s) {
+            auto h = reinterpret_cast<const Header*>(view.data() + (s - segs[i]) * this->recordSize);
+            if(!this->isValid(h, s)) {
+                throw std::runtime_error("journal " + this->option.dir + " is corrupted at " + std::to_string(s));
+            }
+            if(h->time >= minTime) {
+                f(s, h->time, h + 1);
+            }
+        }
+    }
+    return std::max(from, end);
+}
+
+std::string shochu::Journal::segmentPath(uint64_t firstSeq) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu.log", static_cast<unsigned long long>(firstSeq));
+    return (std::filesystem::path(this->option.dir) / name).string();
+}
+
+std::string shochu::Journal::nextPath() const {
+    return (std::filesystem::path(this->option.dir) / "next.tmp").string();
+}
+
+shochu::Journal::Segment shochu::Journal::mapSegment(const std::string& path, bool isCreate) const {
+    int fd = ::open(path.c_str(), O_RDWR | (isCreate ? O_CREAT | O_TRUNC : 0), 0644);
+    if(fd < 0) {
+        throw lastError(path);
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0) {
+        auto e = lastError(path);
+        ::close(fd);
+        throw e;
+    }
+    // 预先分配整段，追加时不再扩展文件
+    if(static_cast<size_t>(st.st_size) < this->option.segmentSize
+       && ::posix_fallocate(fd, 0, this->option.segmentSize) != 0
+       && ::ftruncate(fd, this->option.segmentSize) != 0) {
+        auto e = lastError(path);
+        ::close(fd);
+        throw e;
+    }
+    void* p = ::mmap(nullptr, this->option.segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED) {
+        auto e = lastError(path);
+        ::close(fd);
+        throw e;
+    }
+    if(isCreate) {
+        ::fsync(fd);
+    }
+    Segment s;
+    s.fd = fd;
+    s.base = static_cast<char*>(p);
+    return s;
+}
+
+void shochu::Journal::unmapSegment(Segment& s) const {
+    ::munmap(s.base, this->option.segmentSize);
+    ::close(s.fd);
+    s = Segment();
+}
+
+void shochu::Journal::openSegment(uint64_t firstSeq, bool isCreate) {
+    this->cur = this->mapSegment(this->segmentPath(firstSeq), isCreate);
+    this->cur.firstSeq = firstSeq;
+    if(isCreate) {
+        syncDir(this->option.dir);
+        this->segments.push_back(firstSeq);
+    }
+}
+
+void shochu::Journal::closeSegment() {
+    if(!this->cur.base) {
+        return;
+    }
+    this->syncLocked();
+    this->unmapSegment(this->cur);
+}
+
+void shochu::Journal::closeFull() {
+    if(!this->full.base) {
+        return;
+    }
+    static const size_t PageSize = ::sysconf(_SC_PAGESIZE);
+    size_t begin = this->fullSyncedOff / PageSize * PageSize;
+    if(::msync(this->full.base + begin, this->recordNum * this->recordSize - begin, MS_SYNC) != 0) {
+        this->error.store(errno);
+    }
+    this->unmapSegment(this->full);
+}
+
+void shochu::Journal::syncLocked() {
+    size_t w = this->writtenOff.load(std::memory_order_acquire);
+    if(!this->cur.base || w <= this->syncedOff) {
+        return;
+    }
+    // msync 的起始地址必须按页对齐
+    static const size_t PageSize = ::sysconf(_SC_PAGESIZE);
+    size_t begin = this->syncedOff / PageSize * PageSize;
+    if(::msync(this->cur.base + begin, w - begin, MS_SYNC) != 0) {
+        this->error.store(errno);
+    }
+    this->syncedOff = w;
+}
+
+void shochu::Journal::recover() {
+    this->seq = this->cur.firstSeq;
+    this->writeOff = 0;
+    while(this->seq - this->cur.firstSeq < this->recordNum
+          && this->isValid(reinterpret_cast<const Header*>(this->cur.base + this->writeOff), this->seq)) {
+        this->writeOff += this->recordSize;
+        ++this->seq;
+    }
+    // 写到一半的记录大小为0或 payloadSize，其他值说明日志是以另一种负载创建的，不能清零
+    if(this->seq - this->cur.firstSeq < this->recordNum) {
+        uint32_t size = reinterpret_cast<const Header*>(this->cur.base + this->writeOff)->size;
+        if(size != 0 && size != this->payloadSize) {
+            throw std::invalid_argument("journal " + this->option.dir + " has records of " + std::to_string(size)
+                                        + " bytes, expect " + std::to_string(this->payloadSize));
+        }
+    }
+    // 崩溃时后面的页可能先于前面的页落盘，清掉第一条无效记录之后的内容，
+    // 避免新记录写到一半时旧记录被当成有效记录
+    size_t rest = this->option.segmentSize - this->writeOff;
+    if(rest) {
+        std::memset(this->cur.base + this->writeOff, 0, rest);
+        static const size_t PageSize = ::sysconf(_SC_PAGESIZE);
+        size_t begin = this->writeOff / PageSize * PageSize;
+        ::msync(this->cur.base + begin, this->option.segmentSize - begin, MS_SYNC);
+    }
+    this->committed.store(this->seq);
+    this->writtenOff.store(this->writeOff);
+    this->syncedOff = this->writeOff;
+}
+
+bool shochu::Journal::isValid(const Header* h, uint64_t expectSeq) const {
+    return h->size == this->payloadSize && h->seq == expectSeq && h->check == this->checksum(h, h + 1);
+}
+
+uint32_t shochu::Journal::checksum(const Header* h, const void* p) const {
+    // FNV-1a，覆盖序号、时间和负载
+    uint32_t v = 2166136261u;
+    auto mix = [&v](const void* data, size_t n) {
+        auto b = static_cast<const unsigned char*>(data);
+        for(size_t i=0;i<n;++i) {
+            v = (v ^ b[i]) * 16777619u;
+        }
+    };
+    mix(&h->seq, sizeof(h->seq));
+    mix(&h->time, sizeof(h->time));
+    mix(p, this->payloadSize);
+    return v;
+}
+
+void shochu::Journal::syncThread() {
+    std::unique_lock<std::mutex> l(this->m);
+    while(!this->isQuit) {
+        this->cv.wait_for(l, this->option.syncInterval);
+        this->syncLocked();
+        this->closeFull();
+        if(this->isDirDirty) {
+            syncDir(this->option.dir);
+            this->isDirDirty = false;
+        }
+        if(this->next.base || this->isQuit || this->error.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        // 分配和刷盘较慢，不持有锁；写入线程此时切换会直接以正式名称创建，不会用到这个文件
+        l.unlock();
+        Segment s;
+        try {
+            s = this->mapSegment(this->nextPath(), true);
+        }
+        catch(const std::system_error&) {
+            // 留给切换时同步创建，错误在那里记录
+        }
+        l.lock();
+        this->next = s;
+    }
+}
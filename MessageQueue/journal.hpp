@@ -0,0 +1,140 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * @brief 定长记录的持久化日志
+ * 记录按序号顺序追加到分段的文件中，每段预先分配并映射到内存，
+ * 追加只是把负载复制进映射区域；后台线程每隔 syncInterval 把新写入的部分一次性 msync，
+ * 即组提交，写入线程不等待磁盘
+ * 文件位于 dir 下，名称为该段第一条记录的序号，重新打开时从最后一段恢复写入位置；
+ * 后台线程预先分配下一段并关闭写满的段，写满时写入线程只需把预分配的文件改名
+ * @code {.cpp}
+ * Journal j({"journal/sample"}, &messageTypeTag<Sample>, sizeof(Sample));
+ * j.append(&sample);
+ * j.replay(0, [](uint64_t seq, int64_t time, const void* p) { ... });
+ * @endcode
+ * @note 只能有一个线程调用 append，replay 可以在任意线程与 append 同时调用
+ * @note 只支持 POSIX 系统
+ */
+namespace shochu {
+
+struct JournalOption {
+    // 日志文件所在目录，不存在时创建，每个日志应使用单独的目录
+    std::string dir;
+    // 每段文件的大小，重新打开已有的日志时必须与创建时相同
+    size_t segmentSize = 64 << 20;
+    // 组提交的间隔，崩溃时最多丢失这段时间内写入的记录
+    std::chrono::milliseconds syncInterval{10};
+};
+
+class Journal {
+public:
+    // type 用于校验回放时的负载类型，payloadSize 为每条记录负载的字节数
+    // 打开或恢复文件失败时抛出 std::system_error，已有记录的负载大小不是 payloadSize 时抛出 std::invalid_argument
+    Journal(const JournalOption& option, const void* type, size_t payloadSize);
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    // 刷盘后关闭
+    ~Journal();
+
+    // 追加一条记录，p 指向 payloadSize 字节的负载，返回该记录的序号
+    // 写文件失败后不再追加，返回 UINT64_MAX，replay 时抛出该错误
+    uint64_t append(const void* p);
+
+    // 回放序号不小于 from 的已追加记录，f(seq, time, payload)，time 为追加时 system_clock 的纳秒数
+    // 只回放调用时已经追加的记录，返回此时的 nextSeq，之后的记录由订阅接收
+    uint64_t replay(uint64_t from, const std::function<void(uint64_t, int64_t, const void*)>& f) const;
+    // 回放追加时间不早于 t 的记录
+    uint64_t replaySince(std::chrono::system_clock::time_point t, const std::function<void(uint64_t, int64_t, const void*)>& f) const;
+
+    // 下一条记录的序号，即已追加的记录数
+    uint64_t nextSeq() const {
+        return this->committed.load(std::memory_order_acquire);
+    }
+    const void* type() const {
+        return this->type_;
+    }
+
+private:
+    struct Header {
+        uint32_t size;
+        uint32_t check;
+        uint64_t seq;
+        int64_t time;
+    };
+    struct Segment {
+        uint64_t firstSeq = 0;
+        int fd = -1;
+        char* base = nullptr;
+    };
+
+    const JournalOption option;
+    const void* type_;
+    const size_t payloadSize;
+    // 记录按8字节对齐，每段的记录数固定，可以直接由序号算出位置
+    const size_t recordSize;
+    const size_t recordNum;
+
+    // 以下由写入线程修改，cur 和 segments 的修改同时持有 m
+    Segment cur;
+    size_t writeOff;
+    uint64_t seq;
+    std::atomic<uint64_t> committed;
+    std::atomic<size_t> writtenOff;
+    std::atomic<int> error;
+
+    mutable std::mutex m;
+    // 各段第一条记录的序号，升序
+    std::vector<uint64_t> segments;
+    size_t syncedOff;
+    // 后台线程预先分配的下一段，以临时文件名存在，切换时改名
+    Segment next;
+    // 已写满、等待后台线程刷盘后关闭的段，fullSyncedOff 之前的部分已经刷盘
+    Segment full;
+    size_t fullSyncedOff;
+    // 切换后新段的目录项还没有刷盘
+    bool isDirDirty;
+
+    std::condition_variable cv;
+    bool isQuit;
+    std::thread th;
+
+    std::string segmentPath(uint64_t firstSeq) const;
+    std::string nextPath() const;
+    // 打开 path 并映射整段，isCreate 时新建并预先分配，失败时抛出 std::system_error
+    Segment mapSegment(const std::string& path, bool isCreate) const;
+    void unmapSegment(Segment& s) const;
+    // 持有 m 时调用，创建或打开序号从 firstSeq 开始的段并映射
+    void openSegment(uint64_t firstSeq, bool isCreate);
+    // 持有 m 时调用，把写入的部分刷盘后关闭当前段
+    void closeSegment();
+    // 持有 m 时调用，把写满的段剩余的部分刷盘后关闭
+    void closeFull();
+    // 当前段写满时切换到下一段，失败时记录错误并返回 false
+    bool rollover();
+    // 持有 m 时调用，把 [syncedOff, writtenOff) 刷盘
+    void syncLocked();
+    // 从当前段开头扫描有效记录，确定写入位置，清零之后的部分
+    // 遇到负载大小不同的记录时抛出 std::invalid_argument，不清零
+    void recover();
+    // 回放 [from, end) 中 time 不小于 minTime 的记录
+    uint64_t scan(uint64_t from, int64_t minTime, const std::function<void(uint64_t, int64_t, const void*)>& f) const;
+    bool isValid(const Header* h, uint64_t expectSeq) const;
+    uint32_t checksum(const Header* h, const void* p) const;
+    void syncThread();
+};
+
+}
+
+#endif // _JOURNAL_H_
@@ -0,0 +1,180 @@
+#ifndef _MESSAGE_H_
+#define _MESSAGE_H_
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+#include "slabPool.hpp"
+
+/**
+ * @brief 消息队列内部传递的消息
+ * 负载与消息头放在同一块内存中，内存按大小从 SlabPool 分配；
+ * 消息带引用计数，分发给多个订阅者时只增加计数，不复制负载
+ * @code {.cpp}
+ * MessageRef m = makeMessage<Sample>(topic, sample);
+ * if(const Sample* s = m->get<Sample>()) { ... }
+ * @endcode
+ */
+namespace shochu {
+
+// topic 的编号，从0开始连续分配，不会回收
+using TopicID = uint32_t;
+constexpr TopicID InvalidTopicID = UINT32_MAX;
+// 没有写入日志的消息的日志序号
+constexpr uint64_t InvalidJournalSeq = UINT64_MAX;
+
+// 每个类型一个唯一地址，用作运行时的类型标识
+template<typename T>
+inline constexpr char messageTypeTag = 0;
+
+class MessageBase {
+public:
+    TopicID topic() const {
+        return this->topic_;
+    }
+    // 消息的来源，本进程投递的为0，从其他进程转发来的由传输层指定
+    uint32_t origin() const {
+        return this->origin_;
+    }
+    // 构造时间，用于统计消息在队列中等待的时间
+    std::chrono::steady_clock::time_point createTime() const {
+        return this->createTime_;
+    }
+    // 开启日志的 topic 中为该消息在日志中的序号，与 replay 的序号相同，否则为 InvalidJournalSeq
+    uint64_t journalSeq() const {
+        return this->journalSeq_;
+    }
+
+    // 负载类型为 T 时返回负载，否则返回 nullptr
+    template<typename T>
+    const T* get() const;
+
+    template<typename T>
+    bool is() const {
+        return this->type == &messageTypeTag<T>;
+    }
+
+protected:
+    MessageBase(TopicID topic, uint32_t origin, const void* type, void (*destroy)(MessageBase*)) :
+        topic_(topic), origin_(origin), createTime_(std::chrono::steady_clock::now()), journalSeq_(InvalidJournalSeq),
+        type(type), refNum(1), destroy(destroy) {}
+
+private:
+    friend class MessageRef;
+    friend class MessageQueue;
+
+    TopicID topic_;
+    uint32_t origin_;
+    std::chrono::steady_clock::time_point createTime_;
+    // 分发线程追加到日志后、交给订阅者之前写入
+    mutable uint64_t journalSeq_;
+    const void* type;
+    std::atomic<uint32_t> refNum;
+    void (*destroy)(MessageBase*);
+};
+
+template<typename T>
+class TypedMessage : public MessageBase {
+public:
+    template<typename... Args>
+    TypedMessage(TopicID topic, uint32_t origin, Args&&... args) :
+        MessageBase(topic, origin, &messageTypeTag<T>, &TypedMessage::destroyThis),
+        value(std::forward<Args>(args)...) {}
+
+    T value;
+
+    static void* operator new(size_t n) {
+        if constexpr (alignof(TypedMessage) > alignof(std::max_align_t)) {
+            return ::operator new(n, std::align_val_t(alignof(TypedMessage)));
+        }
+        else {
+            return SlabPool<sizeof(TypedMessage)>::allocate();
+        }
+    }
+    static void operator delete(void* p) {
+        if constexpr (alignof(TypedMessage) > alignof(std::max_align_t)) {
+            ::operator delete(p, std::align_val_t(alignof(TypedMessage)));
+        }
+        else {
+            SlabPool<sizeof(TypedMessage)>::deallocate(p);
+        }
+    }
+
+private:
+    static void destroyThis(MessageBase* m) {
+        delete static_cast<TypedMessage*>(m);
+    }
+};
+
+template<typename T>
+const T* MessageBase::get() const {
+    if(!this->is<T>()) {
+        return nullptr;
+    }
+    return &static_cast<const TypedMessage<T>*>(this)->value;
+}
+
+// 消息的引用计数指针
+class MessageRef {
+public:
+    MessageRef() noexcept : m(nullptr) {}
+    explicit MessageRef(MessageBase* m) noexcept : m(m) {}
+    MessageRef(const MessageRef& o) noexcept : m(o.m) {
+        if(this->m) {
+            this->m->refNum.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    MessageRef(MessageRef&& o) noexcept : m(o.m) {
+        o.m = nullptr;
+    }
+    MessageRef& operator=(MessageRef o) noexcept {
+        std::swap(this->m, o.m);
+        return *this;
+    }
+    ~MessageRef() {
+        this->reset();
+    }
+
+    void reset() {
+        if(this->m && this->m->refNum.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->m->destroy(this->m);
+        }
+        this->m = nullptr;
+    }
+
+    const MessageBase* get() const {
+        return this->m;
+    }
+    const MessageBase* operator->() const {
+        return this->m;
+    }
+    const MessageBase& operator*() const {
+        return *this->m;
+    }
+    explicit operator bool() const {
+        return this->m != nullptr;
+    }
+
+private:
+    MessageBase* m;
+};
+
+template<typename T, typename... Args>
+MessageRef makeMessage(TopicID topic, Args&&... args) {
+    return MessageRef(new TypedMessage<T>(topic, 0, std::forward<Args>(args)...));
+}
+
+// 构造来自 origin 的消息，见 MessageBase::origin
+template<typename T, typename... Args>
+MessageRef makeMessageFrom(uint32_t origin, TopicID topic, Args&&... args) {
+    return MessageRef(new TypedMessage<T>(topic, origin, std::forward<Args>(args)...));
+}
+
+}
+
+#endif // _MESSAGE_H_
@@ -1,11 +1,153 @@
 #include "messageQueue.h"
 
+#include <bit>
 #include <thread>
-#include <unistd.h>
+#include <shared_mutex>
+#include <iostream>
+#include <algorithm>
+#include <string_view>
 
-#include "../ThreadPool/threadPool.hpp"
+namespace {
+std::shared_mutex topicMutex;
+std::unordered_map<std::string, shochu::TopicID> topicIDs;
+// 名称按块存放，块分配后不再移动，topicName 返回的引用一直有效，读取时不加锁
+constexpr size_t NameChunkBits = 10;
+constexpr size_t NameChunkSize = size_t(1) << NameChunkBits;
+constexpr size_t MaxNameChunkNum = 4096;
+std::atomic<std::string*> nameChunks[MaxNameChunkNum];
+size_t topicNum = 0;
+// 每个线程缓存的 topic 数，超过时清空重来
+constexpr size_t TopicCacheNum = 4096;
 
-shochu::Event::Event(const std::string& t) : topic_(t){
+std::vector<std::string_view> splitTopic(std::string_view topic) {
+    std::vector<std::string_view> levels;
+    size_t b = 0;
+    while(true) {
+        size_t e = topic.find('/', b);
+        if(e == std::string_view::npos) {
+            levels.push_back(topic.substr(b));
+            return levels;
+        }
+        levels.push_back(topic.substr(b, e - b));
+        b = e + 1;
+    }
+}
+
+// 每个线程固定使用一个分片
+size_t threadShard(size_t n) {
+    static std::atomic<size_t> next{0};
+    thread_local size_t i = next.fetch_add(1, std::memory_order_relaxed);
+    return i % n;
+}
+
+bool isPattern(const std::string& topic) {
+    return topic.find_first_of("+#") != std::string::npos;
+}
+
+// + 和 # 必须单独占一级，# 只能在最后一级
+void checkPattern(const std::string& pattern) {
+    auto levels = splitTopic(pattern);
+    for(size_t i=0;i<levels.size();++i) {
+        bool isWildcard = levels[i] == "+" || levels[i] == "#";
+        if((!isWildcard && levels[i].find_first_of("+#") != std::string_view::npos)
+           || (levels[i] == "#" && i + 1 != levels.size())) {
+            throw std::invalid_argument("invalid topic pattern " + pattern);
+        }
+    }
+}
+
+template<typename... Ts>
+bool integralKey(const std::any& v, uint64_t& key) {
+    return ((std::any_cast<Ts>(&v) ? (key = static_cast<uint64_t>(*std::any_cast<Ts>(&v)), true) : false) || ...);
+}
+
+// 把 Event 字段的值转为合并用的 key，字符串取哈希
+bool anyKey(const std::any& v, uint64_t& key) {
+    if(integralKey<int, unsigned, long, unsigned long, long long, unsigned long long, short, unsigned short, char>(v, key)) {
+        return true;
+    }
+    if(auto p = std::any_cast<std::string>(&v)) {
+        key = std::hash<std::string>()(*p);
+        return true;
+    }
+    if(auto p = std::any_cast<const char*>(&v)) {
+        key = std::hash<std::string_view>()(*p);
+        return true;
+    }
+    return false;
+}
+
+bool matchPattern(const std::string& pattern, const std::string& topic) {
+    auto p = splitTopic(pattern);
+    auto t = splitTopic(topic);
+    for(size_t i=0;i<p.size();++i) {
+        if(p[i] == "#") {
+            return true;
+        }
+        if(i >= t.size() || (p[i] != "+" && p[i] != t[i])) {
+            return false;
+        }
+    }
+    return p.size() == t.size();
+}
+}
+
+shochu::TopicID shochu::internTopic(const std::string& topic) {
+    // 编号分配后不再改变，各线程缓存查过的 topic，命中时不访问共享数据
+    thread_local std::unordered_map<std::string, TopicID> cache;
+    auto c = cache.find(topic);
+    if(c != cache.end()) {
+        return c->second;
+    }
+    if(cache.size() >= TopicCacheNum) {
+        cache.clear();
+    }
+
+    TopicID id;
+    std::shared_lock<std::shared_mutex> rl(topicMutex);
+    auto it = topicIDs.find(topic);
+    if(it != topicIDs.end()) {
+        id = it->second;
+    }
+    else {
+        rl.unlock();
+        std::lock_guard<std::shared_mutex> l(topicMutex);
+        it = topicIDs.find(topic);
+        if(it != topicIDs.end()) {
+            id = it->second;
+        }
+        else {
+            size_t chunk = topicNum >> NameChunkBits;
+            if(chunk >= MaxNameChunkNum) {
+                throw std::length_error("too many topics");
+            }
+            std::string* names = nameChunks[chunk].load(std::memory_order_relaxed);
+            if(!names) {
+                names = new std::string[NameChunkSize];
+            }
+            names[topicNum & (NameChunkSize - 1)] = topic;
+            nameChunks[chunk].store(names, std::memory_order_release);
+            id = static_cast<TopicID>(topicNum++);
+            topicIDs.emplace(topic, id);
+        }
+    }
+    cache.emplace(topic, id);
+    return id;
+}
+
+const std::string& shochu::topicName(TopicID id) {
+    return nameChunks[id >> NameChunkBits].load(std::memory_order_acquire)[id & (NameChunkSize - 1)];
+}
+
+shochu::Event::Event(const std::string& t) : topicID_(internTopic(t)) {
+}
+
+shochu::Event::Event(TopicID id) : topicID_(id) {
+}
+
+const std::string& shochu::Event::topic() const {
+    static const std::string empty;
+    return this->topicID_ == InvalidTopicID ? empty : topicName(this->topicID_);
 }
 
 void shochu::Event::insert(const std::string& k, const std::any& v) {
@@ -19,71 +161,704 @@ std::any& shochu::Event::operator[](const std::string& k) {
     return this->data[k];
 }
 
+const std::any* shochu::Event::find(const std::string& k) const {
+    auto it = this->data.find(k);
+    return it == this->data.end() ? nullptr : &it->second;
+}
+
+struct shochu::EventAwaiter::State {
+    std::mutex m;
+    bool isFired = false;
+    int id = 0;
+    std::coroutine_handle<> h;
+    Event e;
+};
+
+shochu::EventAwaiter::EventAwaiter(MessageQueue* mq, const std::string& topic) :
+    mq(mq),
+    topic(topic),
+    state(std::make_shared<State>()) {
+}
+
+void shochu::EventAwaiter::await_suspend(std::coroutine_handle<> h) {
+    // 注册完成前收到的消息在锁上等待，保证恢复时 id 已经写入
+    std::lock_guard<std::mutex> l(this->state->m);
+    this->state->h = h;
+    this->state->id = this->mq->registerSubscripter(this->topic, [s = this->state](Event e) {
+        std::lock_guard<std::mutex> l(s->m);
+        if(s->isFired) {
+            return;
+        }
+        s->isFired = true;
+        s->e = std::move(e);
+        shochu::ThreadPool::getInstance()->addTask(shochu::CancelToken::none(), shochu::ResumeTask(s->h));
+    });
+}
+
+shochu::Event shochu::EventAwaiter::await_resume() {
+    this->mq->unregisterSubscripter(this->state->id);
+    return std::move(this->state->e);
+}
+
+shochu::EventAwaiter shochu::MessageQueue::nextEvent(const std::string& topic) {
+    return EventAwaiter(this, topic);
+}
+
+// Dedicated 方式的 topic 独占的线程，按投递顺序调用订阅者
+class shochu::MessageQueue::DedicatedThread {
+public:
+    explicit DedicatedThread(MessageQueue* mq) : mq(mq), wakeSeq(0), isWaiting(false), isQuit(false) {
+        this->th = std::thread(&DedicatedThread::run, this);
+    }
+    // 处理完已经投递的消息后退出
+    ~DedicatedThread() {
+        this->isQuit = true;
+        this->wakeSeq.fetch_add(1);
+        this->wakeSeq.notify_one();
+        this->th.join();
+    }
+
+    void post(const std::shared_ptr<Subscriber>& sub, const Delivery& d) {
+        this->q.emplace(sub, d);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(this->isWaiting.load(std::memory_order_relaxed)) {
+            this->wakeSeq.fetch_add(1, std::memory_order_release);
+            this->wakeSeq.notify_one();
+        }
+    }
+
+private:
+    MessageQueue* mq;
+    MpscQueue<std::pair<std::shared_ptr<Subscriber>, Delivery>> q;
+    std::atomic<uint32_t> wakeSeq;
+    std::atomic<bool> isWaiting;
+    std::atomic<bool> isQuit;
+    std::thread th;
+
+    void run() {
+        std::pair<std::shared_ptr<Subscriber>, Delivery> item;
+        while(true) {
+            while(this->q.pop(item)) {
+                MessageRef m = item.first->receive(item.second);
+                if(item.first->isActive) {
+                    this->mq->invoke(*item.first, *m);
+                }
+                item.first.reset();
+            }
+            if(this->isQuit) {
+                break;
+            }
+
+            uint32_t seq = this->wakeSeq.load(std::memory_order_acquire);
+            this->isWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(this->q.empty() && !this->isQuit) {
+                this->wakeSeq.wait(seq, std::memory_order_acquire);
+            }
+            this->isWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+};
+
+// 处理订阅者消息的线程池任务，没有执行就被丢弃时在析构中处理，
+// 否则 pendingNum 不会归零，该订阅者再也收不到消息
+class shochu::MessageQueue::DrainTask {
+public:
+    DrainTask(MessageQueue* mq, const std::shared_ptr<Subscriber>& sub) : mq(mq), sub(sub) {}
+    DrainTask(DrainTask&& o) noexcept : mq(std::exchange(o.mq, nullptr)), sub(std::move(o.sub)) {}
+    DrainTask& operator=(DrainTask&&) = delete;
+    ~DrainTask() {
+        if(this->mq) {
+            this->mq->drainMailbox(this->sub);
+        }
+    }
+
+    void operator()() {
+        std::exchange(this->mq, nullptr)->drainMailbox(this->sub);
+    }
+    // 投递失败时由调用方处理
+    void release() noexcept {
+        this->mq = nullptr;
+    }
+
+private:
+    MessageQueue* mq;
+    std::shared_ptr<Subscriber> sub;
+};
+
+struct shochu::MessageQueue::PatternNode {
+    std::unordered_map<std::string, std::unique_ptr<PatternNode>> children;
+    // pattern 在此结束的订阅者
+    std::vector<std::shared_ptr<Subscriber>> subs;
+    // pattern 在此之后为 # 的订阅者
+    std::vector<std::shared_ptr<Subscriber>> restSubs;
+
+    void insert(const std::vector<std::string_view>& levels, const std::shared_ptr<Subscriber>& sub) {
+        PatternNode* n = this;
+        for(auto level : levels) {
+            if(level == "#") {
+                n->restSubs.push_back(sub);
+                return;
+            }
+            auto& c = n->children[std::string(level)];
+            if(!c) {
+                c = std::make_unique<PatternNode>();
+            }
+            n = c.get();
+        }
+        n->subs.push_back(sub);
+    }
+
+    void erase(const std::vector<std::string_view>& levels, const std::shared_ptr<Subscriber>& sub) {
+        PatternNode* n = this;
+        for(auto level : levels) {
+            if(level == "#") {
+                std::erase(n->restSubs, sub);
+                return;
+            }
+            auto it = n->children.find(std::string(level));
+            if(it == n->children.end()) {
+                return;
+            }
+            n = it->second.get();
+        }
+        std::erase(n->subs, sub);
+    }
+
+    void match(const std::vector<std::string_view>& levels, size_t i, std::vector<std::shared_ptr<Subscriber>>& out) const {
+        out.insert(out.end(), this->restSubs.begin(), this->restSubs.end());
+        if(i == levels.size()) {
+            out.insert(out.end(), this->subs.begin(), this->subs.end());
+            return;
+        }
+        auto it = this->children.find(std::string(levels[i]));
+        if(it != this->children.end()) {
+            it->second->match(levels, i + 1, out);
+        }
+        it = this->children.find("+");
+        if(it != this->children.end()) {
+            it->second->match(levels, i + 1, out);
+        }
+    }
+};
+
+bool shochu::MessageQueue::Subscriber::offer(const MessageRef& m, uint64_t key) {
+    std::lock_guard<std::mutex> l(this->conflateMutex);
+    auto [it, isNew] = this->latest.try_emplace(std::make_pair(m->topic(), key), m);
+    if(!isNew) {
+        it->second = m;
+    }
+    return isNew;
+}
+
+shochu::MessageRef shochu::MessageQueue::Subscriber::receive(Delivery& d) {
+    if(!d.isConflated) {
+        return std::move(d.m);
+    }
+    TopicID topic = d.m->topic();
+    d.m.reset();
+    std::lock_guard<std::mutex> l(this->conflateMutex);
+    auto it = this->latest.find(std::make_pair(topic, d.key));
+    MessageRef m = std::move(it->second);
+    this->latest.erase(it);
+    return m;
+}
+
 shochu::MessageQueue* shochu::MessageQueue::getInstance() {
     static shochu::MessageQueue lib;
     return &lib;
 }
 
-shochu::MessageQueue::MessageQueue() {
-    this->isQuit = false;
-    this->funcID = 1;
-    std::thread(&shochu::MessageQueue::handlePostMessageThread, this).detach();
+shochu::MessageQueue::MessageQueue() :
+    funcID(1),
+    patterns(std::make_unique<PatternNode>()),
+    patternNum(0),
+    routes(new RouteTable),
+    globalEpoch(1),
+    readerEpoch(0),
+    wakeSeq(0),
+    isWaiting(false),
+    isQuit(false),
+    dispatchedNum(0),
+    unroutedNum(0),
+    dispatchingTime(0),
+    isTiming(true),
+    slowThreshold(0) {
+    // 线程池先于消息队列构造，静态对象按相反顺序析构，保证析构时线程池还在
+    ThreadPool::getInstance();
+    this->th = std::thread(&shochu::MessageQueue::handlePostMessageThread, this);
 }
 
 shochu::MessageQueue::~MessageQueue() {
     this->isQuit = true;
+    this->wakeSeq.fetch_add(1);
+    this->wakeSeq.notify_one();
+    if(this->th.joinable()) {
+        this->th.join();
+    }
+
+    // 独占线程处理剩余消息时还会用到其他成员，在它们析构之前先停止
+    this->dedicatedThreads.clear();
+    // 等待线程池中处理剩余消息的任务结束，之后它们不再访问本对象
+    for(auto& [id, sub] : this->funcs) {
+        while(sub->pendingNum.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    delete this->routes.load();
+    for(auto& r : this->retired) {
+        delete r.first;
+    }
+}
+
+int shochu::MessageQueue::registerSubscripter(const std::string& topic, std::function<void(Event)> func) {
+    return this->addSubscriber(topic, [f = std::move(func)](const MessageBase& m) {
+        if(const Event* e = m.get<Event>()) {
+            f(*e);
+        }
+    });
+}
+
+int shochu::MessageQueue::registerSubscripter(TopicID topic, std::function<void(Event)> func) {
+    // 兼容接口，每个订阅者收到一份 Event 的复制
+    return this->addSubscriber(topic, [f = std::move(func)](const MessageBase& m) {
+        if(const Event* e = m.get<Event>()) {
+            f(*e);
+        }
+    });
+}
 
-    struct timespec t{.tv_sec=1, .tv_nsec=0};
-    while(this->isQuit) {
-        nanosleep(&t, nullptr);
+int shochu::MessageQueue::addSubscriber(TopicID topic, std::function<void(const MessageBase&)>&& func) {
+    std::lock_guard<std::mutex> l(this->wMutex);
+    int id = this->funcID++;
+    auto sub = std::make_shared<Subscriber>(id, topic, std::move(func));
+    this->funcs.emplace(id, sub);
+    this->exactSubs[topic].push_back(sub);
+    this->updateRoute(topic, [](Route&) {});
+    return id;
+}
+
+int shochu::MessageQueue::addSubscriber(const std::string& topic, std::function<void(const MessageBase&)>&& func) {
+    if(!isPattern(topic)) {
+        return this->addSubscriber(internTopic(topic), std::move(func));
     }
+    checkPattern(topic);
+    std::lock_guard<std::mutex> l(this->wMutex);
+    int id = this->funcID++;
+    auto sub = std::make_shared<Subscriber>(id, InvalidTopicID, std::move(func));
+    sub->pattern = topic;
+    this->funcs.emplace(id, sub);
+    this->patterns->insert(splitTopic(topic), sub);
+    this->patternNum.fetch_add(1);
+    this->refreshPattern(topic);
+    return id;
 }
 
 void shochu::MessageQueue::unregisterSubscripter(int no) {
-    this->funcs.erase(no);
+    std::lock_guard<std::mutex> l(this->wMutex);
+    auto it = this->funcs.find(no);
+    if(it == this->funcs.end()) {
+        return;
+    }
+    std::shared_ptr<Subscriber> sub = std::move(it->second);
+    this->funcs.erase(it);
+    sub->isActive = false;
+    if(!sub->pattern.empty()) {
+        this->patterns->erase(splitTopic(sub->pattern), sub);
+        this->patternNum.fetch_sub(1);
+        this->refreshPattern(sub->pattern);
+        return;
+    }
+    auto exact = this->exactSubs.find(sub->topic);
+    std::erase(exact->second, sub);
+    if(exact->second.empty()) {
+        this->exactSubs.erase(exact);
+    }
+    this->updateRoute(sub->topic, [](Route&) {});
+}
+
+void shochu::MessageQueue::setDispatchMode(const std::string& topic, DispatchMode mode) {
+    this->setDispatchMode(internTopic(topic), mode);
+}
+
+void shochu::MessageQueue::setDispatchMode(TopicID topic, DispatchMode mode) {
+    std::lock_guard<std::mutex> l(this->wMutex);
+    if(mode == Inline && this->conflations.count(topic)) {
+        throw std::invalid_argument("conflation of " + topicName(topic) + " requires Pooled or Dedicated dispatch mode");
+    }
+    DedicatedThread* t = nullptr;
+    if(mode == Dedicated) {
+        auto& th = this->dedicatedThreads[topic];
+        if(!th) {
+            th = std::make_unique<DedicatedThread>(this);
+        }
+        t = th.get();
+    }
+    this->updateRoute(topic, [mode, t](Route& r) {
+        r.mode = mode;
+        r.thread = t;
+    });
+}
+
+void shochu::MessageQueue::setConflation(const std::string& topic, const std::string& field) {
+    this->setConflation(internTopic(topic), field);
+}
+
+void shochu::MessageQueue::setConflation(TopicID topic, const std::string& field) {
+    this->addConflation(topic, [field](const MessageBase& m, uint64_t& key) {
+        const Event* e = m.get<Event>();
+        const std::any* v = e ? e->find(field) : nullptr;
+        return v && anyKey(*v, key);
+    });
+}
+
+void shochu::MessageQueue::addConflation(TopicID topic, std::function<bool(const MessageBase&, uint64_t&)>&& keyOf) {
+    std::lock_guard<std::mutex> l(this->wMutex);
+    const Route* r = this->routes.load()->find(topic);
+    if(!r || r->mode == Inline) {
+        throw std::invalid_argument("conflation of " + topicName(topic) + " requires Pooled or Dedicated dispatch mode");
+    }
+    auto& c = this->conflations[topic];
+    if(c) {
+        throw std::invalid_argument("conflation of " + topicName(topic) + " is already set");
+    }
+    c = std::make_unique<Conflation>();
+    c->keyOf = std::move(keyOf);
+    Conflation* p = c.get();
+    this->updateRoute(topic, [p](Route& r) {
+        r.conflation = p;
+    });
+}
+
+uint64_t shochu::MessageQueue::getCoalescedNum(const std::string& topic) {
+    return this->getCoalescedNum(internTopic(topic));
+}
+
+uint64_t shochu::MessageQueue::getCoalescedNum(TopicID topic) {
+    std::lock_guard<std::mutex> l(this->wMutex);
+    auto it = this->conflations.find(topic);
+    return it == this->conflations.end() ? 0 : it->second->coalescedNum.load(std::memory_order_relaxed);
+}
+
+void shochu::MessageQueue::updateRoute(TopicID topic, const std::function<void(Route&)>& f) {
+    this->updateRoutes({topic}, f);
+}
+
+void shochu::MessageQueue::updateRoutes(const std::vector<TopicID>& topics, const std::function<void(Route&)>& f) {
+    const RouteTable* old = this->routes.load();
+    auto table = new RouteTable(*old);
+    // 每块在这次修改中只复制一次
+    std::unordered_map<size_t, std::shared_ptr<RouteChunk>> copied;
+    for(TopicID topic : topics) {
+        size_t i = topic >> RouteChunkBits;
+        if(table->chunks.size() <= i) {
+            table->chunks.resize(i + 1);
+        }
+        auto& chunk = copied[i];
+        if(!chunk) {
+            chunk = table->chunks[i] ? std::make_shared<RouteChunk>(*table->chunks[i]) : std::make_shared<RouteChunk>();
+            table->chunks[i] = chunk;
+        }
+        auto& slot = (*chunk)[topic & (RouteChunkSize - 1)];
+        auto route = slot ? std::make_shared<Route>(*slot) : std::make_shared<Route>();
+        f(*route);
+        route->subs = this->collectSubs(topic);
+        auto& metrics = this->topicMetrics[topic];
+        if(!metrics) {
+            metrics = std::make_unique<TopicMetrics>();
+        }
+        route->metrics = metrics.get();
+        slot = std::move(route);
+    }
+
+    this->routes.store(table);
+    this->retired.emplace_back(old, this->globalEpoch.fetch_add(1));
+    this->reclaim();
+}
+
+std::vector<std::shared_ptr<shochu::MessageQueue::Subscriber>> shochu::MessageQueue::collectSubs(TopicID topic) const {
+    std::vector<std::shared_ptr<Subscriber>> subs;
+    auto it = this->exactSubs.find(topic);
+    if(it != this->exactSubs.end()) {
+        subs = it->second;
+    }
+    if(this->patternNum.load(std::memory_order_relaxed)) {
+        this->patterns->match(splitTopic(topicName(topic)), 0, subs);
+        // 发布到字面含有 + 的 topic 时同一订阅者可能匹配两次
+        std::sort(subs.begin(), subs.end(), [](const std::shared_ptr<Subscriber>& a, const std::shared_ptr<Subscriber>& b) {
+            return a->id < b->id;
+        });
+        subs.erase(std::unique(subs.begin(), subs.end()), subs.end());
+    }
+    return subs;
+}
+
+void shochu::MessageQueue::refreshPattern(const std::string& pattern) {
+    // 还没有路由的 topic 在第一次分发时匹配
+    const RouteTable* table = this->routes.load();
+    std::vector<TopicID> topics;
+    for(TopicID i=0;i<table->size();++i) {
+        if(table->find(i) && matchPattern(pattern, topicName(i))) {
+            topics.push_back(i);
+        }
+    }
+    if(!topics.empty()) {
+        this->updateRoutes(topics, [](Route&) {});
+    }
+}
+
+void shochu::MessageQueue::compileRoute(TopicID topic) {
+    std::lock_guard<std::mutex> l(this->wMutex);
+    if(this->routes.load()->find(topic)) {
+        return;
+    }
+    this->updateRoute(topic, [](Route&) {});
+}
+
+void shochu::MessageQueue::reclaim() {
+    // 分发线程在读 routes 之前写入 readerEpoch，若它读到的是某张旧表，
+    // 写入的纪元一定不大于这张表退役时的纪元
+    uint64_t e = this->readerEpoch.load();
+    std::erase_if(this->retired, [e](const std::pair<const RouteTable*, uint64_t>& r) {
+        if(e != 0 && e <= r.second) {
+            return false;
+        }
+        delete r.first;
+        return true;
+    });
+}
+
+void shochu::MessageQueue::waitDispatch() {
+    // 分发线程每条消息开始时写入当时的纪元，读到的纪元不小于 target 时用的一定是新表
+    uint64_t target = this->globalEpoch.load();
+    while(true) {
+        uint64_t e = this->readerEpoch.load();
+        if(e == 0 || e >= target) {
+            break;
+        }
+        std::this_thread::yield();
+    }
 }
 
 void shochu::MessageQueue::postMessage(const shochu::Event& e) {
-    this->qMutex.lock();
-    this->q.push(e);
-    this->qMutex.unlock();
+    this->enqueue(makeMessage<Event>(e.topicID(), e));
 }
 
 void shochu::MessageQueue::postMessage(shochu::Event&& e) {
-    this->qMutex.lock();
-    this->q.push(std::forward<shochu::Event>(e));
-    this->qMutex.unlock();
+    TopicID topic = e.topicID();
+    this->enqueue(makeMessage<Event>(topic, std::move(e)));
+}
+
+void shochu::MessageQueue::enqueue(MessageRef&& m) {
+    this->postedNum[threadShard(PostCounterNum)].num.fetch_add(1, std::memory_order_relaxed);
+    this->q.push(std::move(m));
+    this->wakeUp();
+}
+
+void shochu::MessageQueue::wakeUp() {
+    // 与分发线程中写 isWaiting 后检查队列配对，两边至少有一方看到对方的写入
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(this->isWaiting.load(std::memory_order_relaxed)) {
+        this->wakeSeq.fetch_add(1, std::memory_order_release);
+        this->wakeSeq.notify_one();
+    }
 }
 
 void shochu::MessageQueue::handlePostMessageThread() {
-    struct timespec t{ .tv_sec=1, .tv_nsec=0 };
+    MessageRef m;
     while(!this->isQuit) {
-        if(!this->q.empty()) {
-            this->qMutex.lock();
-            auto e = this->q.front();
-            this->q.pop();
-            this->qMutex.unlock();
-
-            // 处理消息
-            auto& ids = this->topic2Funcs[e.topic()];
-            for(auto id=ids.begin();id!=ids.end();) {
-                if(this->funcs.find(*id) == this->funcs.end()) {
-                    id = ids.erase(id);
-                }
-                else {
-                    this->funcs[*id](e);
-                    ++id;
+        while(this->q.pop(m)) {
+            this->dispatchingTime.store(m->createTime().time_since_epoch().count(), std::memory_order_relaxed);
+            this->dispatch(m);
+            m.reset();
+            this->dispatchedNum.store(this->dispatchedNum.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        this->dispatchingTime.store(0, std::memory_order_relaxed);
 
-                    // std::shared_ptr<CallFuncType> task(new CallFuncType(dealMeeageUseThreadPool));
-                    // task->data = std::make_tuple(this->funcs[*id].get(), e);
-                    // ThreadPool::getInstance()->addTask(task);
-                }
-            }
+        uint32_t seq = this->wakeSeq.load(std::memory_order_acquire);
+        this->isWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 有投递正在进行时 pop 可能失败但队列不为空，此时不休眠
+        if(this->q.empty() && !this->isQuit) {
+            this->wakeSeq.wait(seq, std::memory_order_acquire);
         }
+        this->isWaiting.store(false, std::memory_order_relaxed);
+    }
+}
 
-        nanosleep(&t, nullptr);
+void shochu::MessageQueue::dispatch(const MessageRef& m) {
+    this->readerEpoch.store(this->globalEpoch.load());
+    TopicID id = m->topic();
+    const Route* route = this->routes.load()->find(id);
+    if(!route && id != InvalidTopicID && this->patternNum.load(std::memory_order_relaxed)) {
+        this->compileRoute(id);
+        route = this->routes.load()->find(id);
+    }
+    if(route && route->journal) {
+        if(const void* p = route->journalPayload(*m)) {
+            m->journalSeq_ = route->journal->append(p);
+        }
+    }
+    // 没有订阅者的路由（只开启了日志，或只表示已经匹配过通配订阅）同样计入 unroutedNum
+    if(!route || route->subs.empty()) {
+        this->readerEpoch.store(0, std::memory_order_release);
+        this->unroutedNum.store(this->unroutedNum.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
     }
 
-    this->isQuit = false;
+    const Route& r = *route;
+    r.metrics->publishNum.store(r.metrics->publishNum.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    Delivery d;
+    d.m = m;
+    d.isConflated = r.conflation && r.conflation->keyOf(*m, d.key);
+    for(auto& sub : r.subs) {
+        // 该订阅者已有同 key 的待处理消息时只替换，不再入队
+        if(d.isConflated && !sub->offer(m, d.key)) {
+            r.conflation->coalescedNum.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        // 通配订阅者可能匹配分发方式不同的多个 topic，都经过它自己的队列才能保持顺序
+        if(!sub->pattern.empty()) {
+            this->postToMailbox(sub, d);
+            continue;
+        }
+        switch(r.mode) {
+        case Inline:
+            this->invoke(*sub, *m);
+            break;
+        case Pooled:
+            this->postToMailbox(sub, d);
+            break;
+        case Dedicated:
+            r.thread->post(sub, d);
+            break;
+        }
+    }
+    this->readerEpoch.store(0, std::memory_order_release);
 }
 
+void shochu::MessageQueue::postToMailbox(const std::shared_ptr<Subscriber>& sub, const Delivery& d) {
+    sub->mailbox.push(d);
+    // 没有任务在处理该订阅者的消息时才投递新任务，保证同一订阅者的消息按顺序处理
+    if(sub->pendingNum.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        DrainTask t(this, sub);
+        if(!ThreadPool::getInstance()->addTask(CancelToken::none(), std::move(t))) {
+            t.release();
+            this->drainMailbox(sub);
+        }
+    }
+}
+
+void shochu::MessageQueue::drainMailbox(const std::shared_ptr<Subscriber>& sub) {
+    while(this->drainBatch(sub)) {
+        DrainTask t(this, sub);
+        if(ThreadPool::getInstance()->addTask(CancelToken::none(), std::move(t))) {
+            return;
+        }
+        t.release();
+    }
+}
+
+bool shochu::MessageQueue::drainBatch(const std::shared_ptr<Subscriber>& sub) {
+    // 每个任务最多处理的消息数，处理不完时重新投递，避免一个订阅者长期占用工作线程
+    constexpr int BatchNum = 64;
+    Delivery d;
+    for(int i=0;i<BatchNum;++i) {
+        // 计数保证消息已经入队，pop 失败只可能是下一条消息正在入队，稍等即可
+        while(!sub->mailbox.pop(d)) {
+            std::this_thread::yield();
+        }
+        MessageRef m = sub->receive(d);
+        if(sub->isActive) {
+            this->invoke(*sub, *m);
+        }
+        if(sub->pendingNum.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void shochu::MessageQueue::invoke(Subscriber& sub, const MessageBase& m) {
+    sub.invokeNum.fetch_add(1, std::memory_order_relaxed);
+    if(!this->isTiming.load(std::memory_order_relaxed)) {
+        sub.func(m);
+        return;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    sub.func(m);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    int i = std::min<int>(std::bit_width(static_cast<uint64_t>(ns)), Histogram::BucketNum - 1);
+    sub.runTime[i].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t threshold = this->slowThreshold.load(std::memory_order_relaxed);
+    if(threshold > 0 && ns >= threshold) {
+        const std::string& topic = sub.pattern.empty() ? topicName(m.topic()) : sub.pattern;
+        std::lock_guard<std::mutex> l(this->slowMutex);
+        if(this->slowLog) {
+            this->slowLog(sub.id, topic, std::chrono::nanoseconds(ns));
+        }
+        else {
+            std::cerr << "MessageQueue: subscriber " << sub.id << " of " << topic << " took " << ns << "ns\n";
+        }
+    }
+}
+
+void shochu::MessageQueue::setTiming(bool isTiming) {
+    this->isTiming = isTiming;
+}
+
+void shochu::MessageQueue::setSlowLog(std::chrono::nanoseconds threshold, SlowLog log) {
+    std::lock_guard<std::mutex> l(this->slowMutex);
+    this->slowLog = std::move(log);
+    this->slowThreshold = threshold.count();
+}
+
+shochu::MessageQueue::Stat shochu::MessageQueue::snapshot() {
+    Stat stat{};
+    // 先读取出数再读投递数，深度不会因为读取顺序小于0
+    stat.dispatchedNum = this->dispatchedNum.load(std::memory_order_relaxed);
+    stat.unroutedNum = this->unroutedNum.load(std::memory_order_relaxed);
+    int64_t dispatching = this->dispatchingTime.load(std::memory_order_relaxed);
+    for(auto& c : this->postedNum) {
+        stat.postedNum += c.num.load(std::memory_order_relaxed);
+    }
+    stat.queueDepth = stat.postedNum > stat.dispatchedNum ? stat.postedNum - stat.dispatchedNum : 0;
+    if(stat.queueDepth && dispatching) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        stat.oldestAge = std::max(std::chrono::nanoseconds(0), std::chrono::duration_cast<std::chrono::nanoseconds>(now - std::chrono::steady_clock::duration(dispatching)));
+    }
+
+    std::lock_guard<std::mutex> l(this->wMutex);
+    const RouteTable* table = this->routes.load();
+    for(TopicID i=0;i<table->size();++i) {
+        const Route* r = table->find(i);
+        if(!r) {
+            continue;
+        }
+        TopicStat ts;
+        ts.id = i;
+        ts.topic = topicName(i);
+        ts.mode = r->mode;
+        ts.publishNum = r->metrics->publishNum.load(std::memory_order_relaxed);
+        ts.coalescedNum = r->conflation ? r->conflation->coalescedNum.load(std::memory_order_relaxed) : 0;
+        stat.topics.push_back(std::move(ts));
+    }
+    for(auto& it : this->funcs) {
+        const Subscriber& sub = *it.second;
+        SubscriberStat ss{};
+        ss.id = sub.id;
+        ss.topic = sub.pattern.empty() ? topicName(sub.topic) : sub.pattern;
+        ss.invokeNum = sub.invokeNum.load(std::memory_order_relaxed);
+        ss.pendingNum = sub.pendingNum.load(std::memory_order_relaxed);
+        for(int i=0;i<Histogram::BucketNum;++i) {
+            ss.runTime.bucket[i] = sub.runTime[i].load(std::memory_order_relaxed);
+        }
+        stat.subscribers.push_back(std::move(ss));
+    }
+    std::sort(stat.subscribers.begin(), stat.subscribers.end(), [](const SubscriberStat& a, const SubscriberStat& b) {
+        return a.id < b.id;
+    });
+    return stat;
+}
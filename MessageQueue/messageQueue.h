@@ -2,13 +2,27 @@
 #define _MESSAGE_QUEUE_H_
 
 #include <any>
-#include <queue>
+#include <array>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <memory>
+#include <coroutine>
+#include <stdexcept>
 #include <functional>
+#include <concepts>
+#include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
+
+#include "channel.hpp"
+#include "journal.hpp"
+#include "message.hpp"
+#include "mpscQueue.hpp"
+#include "../ThreadPool/threadPool.hpp"
 
 /**
  * @brief 消息队列类
@@ -22,64 +36,498 @@
  * Event e("topic");
  * e["key"] = std::any(val);
  * MessageQueue::getInstance()->postMessage(e);
+ *
+ * // 在协程中等待下一条消息
+ * Event e = co_await MessageQueue::getInstance()->nextEvent("topic");
+ *
+ * // 该 topic 的订阅者在线程池中并行处理
+ * MessageQueue::getInstance()->setDispatchMode("topic", MessageQueue::Pooled);
+ *
+ * // 类型化的消息，负载不经过 std::any，订阅者以 const 引用接收
+ * MessageQueue::getInstance()->subscribe<Sample>("sample", [](const Sample& s) { ... });
+ * MessageQueue::getInstance()->post("sample", Sample{...});
+ *
+ * // 通配订阅，+ 匹配一级，# 匹配其后任意多级（包括零级），如 "sensor/+/temp"、"sensor/#"
+ * MessageQueue::getInstance()->subscribe<Sample>("sensor/#", [](const Sample& s) { ... });
+ *
+ * // 只关心最新状态的 topic，订阅者来不及处理时同一 id 的旧消息被新消息替换
+ * MessageQueue::getInstance()->setDispatchMode("quote", MessageQueue::Pooled);
+ * MessageQueue::getInstance()->setConflation<Quote>("quote", [](const Quote& q) { return q.id; });
+ *
+ * // 该 topic 的消息写入日志，之后可以从任意序号或时间回放
+ * MessageQueue::getInstance()->enableJournal<Sample>("sample", {"journal/sample"});
+ * uint64_t next = MessageQueue::getInstance()->replay<Sample>("sample", 0, [](uint64_t seq, const Sample& s) { ... });
  * @endcode
+ * @note 无论哪种分发方式，每个订阅者收到消息的顺序都与投递顺序一致
+ * @note 默认统计各 topic 的消息数、各订阅者的调用次数和耗时，见 snapshot
+ * @note topic 在首次使用时分配编号，分发时按编号查路由表，
+ *       频繁投递的 topic 可以先用 internTopic 取得编号，再用编号构造 Event
+ * @note 通配订阅在 topic 第一次分发时与其匹配，结果并入该 topic 的路由表，
+ *       之后只在订阅变化时重新匹配；通配订阅者的消息不论 topic 的分发方式，
+ *       都经过它自己的队列在线程池中依次处理，匹配多个 topic 时也不会被并发调用
  */
 namespace shochu {
 
+// 返回 topic 的编号，第一次使用时分配，之后各线程从本线程的缓存中查找，不加锁
+TopicID internTopic(const std::string& topic);
+// id 必须是 internTopic 返回的编号，不加锁
+const std::string& topicName(TopicID id);
+
 class Event {
 public:
-    Event() {}
+    Event() : topicID_(InvalidTopicID) {}
     Event(const std::string& t);
+    explicit Event(TopicID id);
 
     void insert(const std::string& k, const std::any& v);
     void insert(const std::string& k, std::any&& v);
 
     std::any& operator[](const std::string& k);
+    // 没有该字段时返回 nullptr
+    const std::any* find(const std::string& k) const;
 
-    inline const std::string& topic() const {
-        return this->topic_;
+    // 按编号查找名称，分发时只使用 topicID
+    const std::string& topic() const;
+    inline TopicID topicID() const {
+        return this->topicID_;
     }
 
 private:
-    std::string topic_;
+    TopicID topicID_;
     std::unordered_map<std::string, std::any> data;
 
 };
 
+class MessageQueue;
+
+// co_await 后等待 topic 的下一条消息，收到后在线程池中恢复，结果为该消息
+class EventAwaiter {
+public:
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h);
+    Event await_resume();
+
+private:
+    friend class MessageQueue;
+
+    struct State;
+
+    EventAwaiter(MessageQueue* mq, const std::string& topic);
+
+    MessageQueue* mq;
+    std::string topic;
+    std::shared_ptr<State> state;
+};
+
 class MessageQueue {
 public:
     static MessageQueue* getInstance();
 
-    // 返回槽编号 取消注册时使用
-    int registerSubscripter(const std::string& topic, std::function<void(Event)> func) {
-        this->funcs.emplace(funcID, func);
-        this->topic2Funcs[topic].insert(funcID);
-        ++funcID;
-
-        return funcID - 1;
-    }
+    // 返回槽编号 取消注册时使用，topic 含有 + 或 # 时为通配订阅，格式错误时抛出 std::invalid_argument
+    int registerSubscripter(const std::string& topic, std::function<void(Event)> func);
+    int registerSubscripter(TopicID topic, std::function<void(Event)> func);
 
     void unregisterSubscripter(int no);
 
     void postMessage(const Event& e);
     void postMessage(Event&& e);
 
+    // 投递负载为 T 的消息，负载与消息头一起从内存池分配，分发给多个订阅者时不复制
+    template<typename T>
+    void post(TopicID topic, T&& v) {
+        this->enqueue(makeMessage<std::decay_t<T>>(topic, std::forward<T>(v)));
+    }
+    template<typename T>
+    void post(const std::string& topic, T&& v) {
+        this->post(internTopic(topic), std::forward<T>(v));
+    }
+
+    // 只接收负载类型为 T 的消息，handler(const T&)，返回值同 registerSubscripter
+    // postMessage 投递的消息负载类型为 Event
+    template<typename T, typename F>
+    requires std::invocable<F&, const T&>
+    int subscribe(TopicID topic, F&& handler) {
+        return this->addSubscriber(topic, [h = std::forward<F>(handler)](const MessageBase& m) mutable {
+            if(const T* v = m.get<T>()) {
+                h(*v);
+            }
+        });
+    }
+    template<typename T, typename F>
+    requires std::invocable<F&, const T&>
+    int subscribe(const std::string& topic, F&& handler) {
+        return this->addSubscriber(topic, [h = std::forward<F>(handler)](const MessageBase& m) mutable {
+            if(const T* v = m.get<T>()) {
+                h(*v);
+            }
+        });
+    }
+
+    // 投递已经构造好的消息，见 makeMessage
+    void post(MessageRef m) {
+        this->enqueue(std::move(m));
+    }
+    // 接收 topic 的所有消息，不区分负载类型，用于转发消息的传输层
+    int subscribeMessage(TopicID topic, std::function<void(const MessageBase&)> handler) {
+        return this->addSubscriber(topic, std::move(handler));
+    }
+
+    // 返回 topic 的环形通道，第一次调用时以 capacity 创建，见 channel.hpp
+    // 通道不经过分发线程，与 post 投递的消息互不影响
+    template<typename T>
+    Channel<T>& openChannel(TopicID topic, size_t capacity = 1 << 16) {
+        std::lock_guard<std::mutex> l(this->wMutex);
+        auto& c = this->channels[topic];
+        if(!c) {
+            c = std::make_unique<Channel<T>>(capacity);
+        }
+        auto p = dynamic_cast<Channel<T>*>(c.get());
+        if(!p) {
+            throw std::invalid_argument("channel " + topicName(topic) + " was opened with another type");
+        }
+        return *p;
+    }
+    template<typename T>
+    Channel<T>& openChannel(const std::string& topic, size_t capacity = 1 << 16) {
+        return this->openChannel<T>(internTopic(topic), capacity);
+    }
+
+    // 合并 topic 中尚未处理的同 key 消息：订阅者还有未处理的同 key 消息时，新消息替换它，
+    // 每个订阅者每个 key 最多保留一条待处理消息；keyOf(const T&) 返回 key，负载不是 T 的消息不合并
+    // Inline 方式下没有按订阅者排队的消息，须先用 setDispatchMode 设为 Pooled 或 Dedicated，
+    // 否则抛出 std::invalid_argument，设置后也不能再切换回 Inline
+    // 应在该 topic 有消息投递之前设置，每个 topic 只能设置一次，重复设置时抛出 std::invalid_argument
+    template<typename T, typename F>
+    requires std::invocable<F&, const T&> && std::convertible_to<std::invoke_result_t<F&, const T&>, uint64_t>
+    void setConflation(TopicID topic, F keyOf) {
+        this->addConflation(topic, [f = std::move(keyOf)](const MessageBase& m, uint64_t& key) mutable {
+            const T* v = m.get<T>();
+            if(v) {
+                key = static_cast<uint64_t>(f(*v));
+            }
+            return v != nullptr;
+        });
+    }
+    template<typename T, typename F>
+    requires std::invocable<F&, const T&> && std::convertible_to<std::invoke_result_t<F&, const T&>, uint64_t>
+    void setConflation(const std::string& topic, F keyOf) {
+        this->setConflation<T>(internTopic(topic), std::move(keyOf));
+    }
+    // 以 Event 中 field 字段的值为 key，字段须为整数或 std::string，没有该字段的消息不合并
+    void setConflation(TopicID topic, const std::string& field);
+    void setConflation(const std::string& topic, const std::string& field);
+    // 被合并掉的消息数
+    uint64_t getCoalescedNum(TopicID topic);
+    uint64_t getCoalescedNum(const std::string& topic);
+
+    // 把 topic 中负载类型为 T 的消息在分发时追加到日志，见 journal.hpp
+    // 负载按字节写入，因此 T 必须可以平凡复制；已有日志时从中恢复序号
+    // 消息在分发前仍只在内存中，日志只记录分发线程取出的消息，不记录通道中的消息
+    template<typename T>
+    requires std::is_trivially_copyable_v<T>
+    void enableJournal(TopicID topic, const JournalOption& option) {
+        std::lock_guard<std::mutex> l(this->wMutex);
+        auto& j = this->journals[topic];
+        if(j) {
+            throw std::invalid_argument("journal of " + topicName(topic) + " is already enabled");
+        }
+        j = std::make_unique<Journal>(option, &messageTypeTag<T>, sizeof(T));
+        Journal* p = j.get();
+        this->updateRoute(topic, [p](Route& r) {
+            r.journal = p;
+            r.journalPayload = [](const MessageBase& m) -> const void* {
+                return m.get<T>();
+            };
+        });
+    }
+    template<typename T>
+    requires std::is_trivially_copyable_v<T>
+    void enableJournal(const std::string& topic, const JournalOption& option) {
+        this->enableJournal<T>(internTopic(topic), option);
+    }
+
+    // 在调用线程中依次回放日志中序号不小于 from 的消息，handler(seq, const T&)
+    // 返回回放结束后的下一个序号；topic 没有开启日志或类型不符时抛出 std::invalid_argument
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    uint64_t replay(TopicID topic, uint64_t from, F&& handler) {
+        return this->journalOf<T>(topic).replay(from, [&handler](uint64_t seq, int64_t, const void* p) {
+            handler(seq, *static_cast<const T*>(p));
+        });
+    }
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    uint64_t replay(const std::string& topic, uint64_t from, F&& handler) {
+        return this->replay<T>(internTopic(topic), from, std::forward<F>(handler));
+    }
+    // 回放分发时间不早于 t 的消息
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    uint64_t replaySince(TopicID topic, std::chrono::system_clock::time_point t, F&& handler) {
+        return this->journalOf<T>(topic).replaySince(t, [&handler](uint64_t seq, int64_t, const void* p) {
+            handler(seq, *static_cast<const T*>(p));
+        });
+    }
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    uint64_t replaySince(const std::string& topic, std::chrono::system_clock::time_point t, F&& handler) {
+        return this->replaySince<T>(internTopic(topic), t, std::forward<F>(handler));
+    }
+    // 与 subscribe 相同，handler(seq, const T&) 同时收到消息的日志序号，写日志失败时为 InvalidJournalSeq
+    // 返回时之后分发的消息都会交给 handler；先订阅再 replay，丢弃序号小于 replay 返回值的消息，
+    // 即可从历史记录不重不漏地衔接到实时消息；会等待分发线程处理完当前消息，不能在 Inline 订阅者中调用
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    int subscribeJournal(TopicID topic, F&& handler) {
+        int id = this->addSubscriber(topic, [h = std::forward<F>(handler)](const MessageBase& m) mutable {
+            if(const T* v = m.get<T>()) {
+                h(m.journalSeq(), *v);
+            }
+        });
+        this->waitDispatch();
+        return id;
+    }
+    template<typename T, typename F>
+    requires std::invocable<F&, uint64_t, const T&>
+    int subscribeJournal(const std::string& topic, F&& handler) {
+        return this->subscribeJournal<T>(internTopic(topic), std::forward<F>(handler));
+    }
+
+    // 只接收一条消息的订阅，见 EventAwaiter
+    EventAwaiter nextEvent(const std::string& topic);
+
+    // 消息的分发方式，按 topic 设置，默认为 Inline
+    enum DispatchMode {
+        Inline,     // 在分发线程中依次调用各订阅者
+        Pooled,     // 每个订阅者的消息在线程池中按顺序处理，不同订阅者之间并行
+        Dedicated   // 该 topic 的消息都在它独占的线程中依次处理，不影响其他 topic
+    };
+    // 应在该 topic 有消息投递之前设置，切换过程中已经分发的消息仍按原方式处理
+    // 已经 setConflation 的 topic 切换为 Inline 时抛出 std::invalid_argument
+    void setDispatchMode(const std::string& topic, DispatchMode mode);
+    void setDispatchMode(TopicID topic, DispatchMode mode);
+
+    using Histogram = ThreadPool::Histogram;
+    struct TopicStat {
+        TopicID id;
+        std::string topic;
+        DispatchMode mode;
+        // 分发给订阅者的消息数，没有订阅者时取出的消息计入 unroutedNum
+        uint64_t publishNum;
+        uint64_t coalescedNum;
+    };
+    struct SubscriberStat {
+        // registerSubscripter 返回的编号
+        int id;
+        // 订阅的 topic 或通配 pattern
+        std::string topic;
+        uint64_t invokeNum;
+        // Pooled 方式下等待处理的消息数
+        size_t pendingNum;
+        Histogram runTime;
+    };
+    struct Stat {
+        // 只包含有路由的 topic，没有订阅者的 topic 中的消息计入 unroutedNum
+        std::vector<TopicStat> topics;
+        std::vector<SubscriberStat> subscribers;
+        uint64_t postedNum;
+        uint64_t dispatchedNum;
+        uint64_t unroutedNum;
+        // 还没有分发完的消息数，以及其中最早一条从构造起已经等待的时间
+        size_t queueDepth;
+        std::chrono::nanoseconds oldestAge;
+    };
+    // 不停止分发，各计数分别读取，彼此之间不保证是同一时刻的值
+    Stat snapshot();
+    // 是否统计订阅者的耗时，默认开启，关闭后也不再记录慢订阅者
+    void setTiming(bool isTiming);
+    // 订阅者单次调用耗时不小于 threshold 时调用 log，log 为空时输出到 std::cerr，threshold 为0时不记录
+    // log 在调用订阅者的线程中执行
+    using SlowLog = std::function<void(int id, const std::string& topic, std::chrono::nanoseconds time)>;
+    void setSlowLog(std::chrono::nanoseconds threshold, SlowLog log = nullptr);
+
 private:
     MessageQueue();
     ~MessageQueue();
 
+    // 投递给订阅者的消息，isConflated 时处理前换成同一 key 的最新消息
+    struct Delivery {
+        MessageRef m;
+        uint64_t key = 0;
+        bool isConflated = false;
+    };
+    struct ConflateKeyHash {
+        size_t operator()(const std::pair<TopicID, uint64_t>& k) const {
+            return std::hash<uint64_t>()(k.second * 31 + k.first);
+        }
+    };
+
+    struct Subscriber {
+        Subscriber(int id, TopicID topic, std::function<void(const MessageBase&)>&& f) :
+            id(id), topic(topic), func(std::move(f)), isActive(true), pendingNum(0) {}
+
+        int id;
+        // 通配订阅的 topic 为 InvalidTopicID，pattern 不为空
+        TopicID topic;
+        std::string pattern;
+        std::function<void(const MessageBase&)> func;
+        // 取消注册后不再处理尚未处理的消息
+        std::atomic<bool> isActive;
+        // Pooled 方式和通配订阅等待处理的消息，同一时刻最多有一个线程池任务在处理
+        MpscQueue<Delivery> mailbox;
+        std::atomic<size_t> pendingNum;
+        // 合并方式下每个 (topic, key) 待处理的最新消息，队列中对应只有一条 Delivery
+        std::mutex conflateMutex;
+        std::unordered_map<std::pair<TopicID, uint64_t>, MessageRef, ConflateKeyHash> latest;
+
+        std::atomic<uint64_t> invokeNum{0};
+        std::atomic<uint64_t> runTime[Histogram::BucketNum]{};
+
+        // 返回 false 表示该 key 已有待处理的消息，m 替换了它，不需要再入队
+        bool offer(const MessageRef& m, uint64_t key);
+        // 取出 d 对应的消息
+        MessageRef receive(Delivery& d);
+    };
+    class DedicatedThread;
+    class DrainTask;
+
+    struct Conflation {
+        // 返回 false 表示该消息不合并
+        std::function<bool(const MessageBase&, uint64_t&)> keyOf;
+        std::atomic<uint64_t> coalescedNum{0};
+    };
+
+    // 只由分发线程写入
+    struct TopicMetrics {
+        std::atomic<uint64_t> publishNum{0};
+    };
+    // 投递计数按线程分片，投递线程之间很少写同一缓存行
+    struct alignas(64) PostCounter {
+        std::atomic<uint64_t> num{0};
+    };
+    static constexpr size_t PostCounterNum = 16;
+
+    // 一个 topic 的路由，发布后不再修改
+    struct Route {
+        DispatchMode mode = Inline;
+        DedicatedThread* thread = nullptr;
+        std::vector<std::shared_ptr<Subscriber>> subs;
+        // 开启日志时 journalPayload 取出负载，类型不符时返回 nullptr
+        Journal* journal = nullptr;
+        const void* (*journalPayload)(const MessageBase&) = nullptr;
+        Conflation* conflation = nullptr;
+        TopicMetrics* metrics = nullptr;
+    };
+    // 按 TopicID 分块，subs 已经并入匹配的通配订阅者
+    // 没有订阅者的 topic 为空；存在通配订阅时，分发过的 topic 即使没有订阅者也有 Route，表示已经匹配过
+    // 修改时只复制块指针数组、被修改的块和 Route，再整体替换，topic 很多时新增一个也不复制整张表
+    static constexpr size_t RouteChunkBits = 8;
+    static constexpr size_t RouteChunkSize = size_t(1) << RouteChunkBits;
+    using RouteChunk = std::array<std::shared_ptr<const Route>, RouteChunkSize>;
+    struct RouteTable {
+        std::vector<std::shared_ptr<const RouteChunk>> chunks;
+
+        size_t size() const {
+            return this->chunks.size() << RouteChunkBits;
+        }
+        const Route* find(TopicID topic) const {
+            size_t i = topic >> RouteChunkBits;
+            if(i >= this->chunks.size() || !this->chunks[i]) {
+                return nullptr;
+            }
+            return (*this->chunks[i])[topic & (RouteChunkSize - 1)].get();
+        }
+    };
+
+    // 以下成员只在持有 wMutex 时修改
+    std::mutex wMutex;
     int funcID;
-    std::unordered_map<int, std::function<void(Event)>> funcs;
+    std::unordered_map<int, std::shared_ptr<Subscriber>> funcs;
+    std::unordered_map<TopicID, std::vector<std::shared_ptr<Subscriber>>> exactSubs;
+    // 通配订阅按层级组成的前缀树
+    struct PatternNode;
+    std::unique_ptr<PatternNode> patterns;
+    // 通配订阅的数量，为0时分发线程不需要为新 topic 匹配路由
+    std::atomic<size_t> patternNum;
+    std::unordered_map<TopicID, std::unique_ptr<DedicatedThread>> dedicatedThreads;
+    std::unordered_map<TopicID, std::unique_ptr<ChannelBase>> channels;
+    std::unordered_map<TopicID, std::unique_ptr<Journal>> journals;
+    std::unordered_map<TopicID, std::unique_ptr<Conflation>> conflations;
+    std::unordered_map<TopicID, std::unique_ptr<TopicMetrics>> topicMetrics;
+
+    // 当前路由表，只有分发线程读取，读取时不加锁也不修改引用计数
+    // 替换下来的旧表记入 retired，确认分发线程不再使用后释放：
+    // 分发线程读取前把 globalEpoch 记入 readerEpoch，读完后清零，
+    // 旧表退役时的纪元小于 readerEpoch 或 readerEpoch 为0时就可以释放
+    std::atomic<const RouteTable*> routes;
+    std::atomic<uint64_t> globalEpoch;
+    std::atomic<uint64_t> readerEpoch;
+    std::vector<std::pair<const RouteTable*, uint64_t>> retired;
 
-    std::unordered_map<std::string, std::unordered_set<int>> topic2Funcs;
-    std::queue<Event> q;
-    std::mutex qMutex;
-    bool isQuit;
+    // 投递线程之间互不阻塞，只有分发线程取出
+    MpscQueue<MessageRef> q;
+    // 分发线程在 wakeSeq 上休眠，isWaiting 为 true 时投递方才需要唤醒
+    std::atomic<uint32_t> wakeSeq;
+    std::atomic<bool> isWaiting;
+    std::atomic<bool> isQuit;
+    std::thread th;
+
+    PostCounter postedNum[PostCounterNum];
+    // 以下三项只由分发线程写入
+    std::atomic<uint64_t> dispatchedNum;
+    std::atomic<uint64_t> unroutedNum;
+    // 正在分发的消息的构造时间，空闲时为0
+    std::atomic<int64_t> dispatchingTime;
+    std::atomic<bool> isTiming;
+    std::atomic<int64_t> slowThreshold;
+    std::mutex slowMutex;
+    SlowLog slowLog;
 
 private:
     // 处理投递来的消息
-    // 如果有消息，则通过线程执行
+    // 没有消息时休眠，被唤醒后处理完所有消息
     void handlePostMessageThread();
+    void dispatch(const MessageRef& m);
+    void enqueue(MessageRef&& m);
+    int addSubscriber(TopicID topic, std::function<void(const MessageBase&)>&& func);
+    // 等待分发线程不再使用调用前的路由表，之后分发的消息都按新的路由表投递
+    void waitDispatch();
+    // topic 含有通配符时加入前缀树，否则同上
+    int addSubscriber(const std::string& topic, std::function<void(const MessageBase&)>&& func);
+    // 持有 wMutex 时调用，复制 topic 的路由交给 f 修改，重新合并订阅者后发布
+    void updateRoute(TopicID topic, const std::function<void(Route&)>& f);
+    // 同上，一次修改多个 topic，只替换一次路由表
+    void updateRoutes(const std::vector<TopicID>& topics, const std::function<void(Route&)>& f);
+    // 持有 wMutex 时调用，返回 topic 的精确订阅者与匹配的通配订阅者，按注册顺序排列
+    std::vector<std::shared_ptr<Subscriber>> collectSubs(TopicID topic) const;
+    // 持有 wMutex 时调用，重新合并已经有路由且与 pattern 匹配的 topic
+    void refreshPattern(const std::string& pattern);
+    // 由分发线程调用，为还没有路由的 topic 匹配通配订阅
+    void compileRoute(TopicID topic);
+    // 持有 wMutex 时调用，释放分发线程已经不再使用的旧路由表
+    void reclaim();
+    void addConflation(TopicID topic, std::function<bool(const MessageBase&, uint64_t&)>&& keyOf);
+    void postToMailbox(const std::shared_ptr<Subscriber>& sub, const Delivery& d);
+    // 处理 sub 的消息，每批之后重新投递任务，线程池拒绝时在当前线程中继续处理
+    void drainMailbox(const std::shared_ptr<Subscriber>& sub);
+    // 处理一批消息，还有剩余时返回 true
+    bool drainBatch(const std::shared_ptr<Subscriber>& sub);
+    // 调用订阅者并记录次数和耗时
+    void invoke(Subscriber& sub, const MessageBase& m);
+    void wakeUp();
+
+    template<typename T>
+    const Journal& journalOf(TopicID topic) {
+        std::lock_guard<std::mutex> l(this->wMutex);
+        auto it = this->journals.find(topic);
+        if(it == this->journals.end() || it->second->type() != &messageTypeTag<T>) {
+            throw std::invalid_argument("journal of " + topicName(topic) + " is not enabled with this type");
+        }
+        // 日志开启后不会关闭，释放锁后仍可以使用
+        return *it->second;
+    }
 
 };
 
@@ -0,0 +1,130 @@
+#ifndef _MPSC_QUEUE_H_
+#define _MPSC_QUEUE_H_
+
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "slabPool.hpp"
+
+/**
+ * @brief 无锁多生产者单消费者队列
+ * 生产者之间只有一次原子交换，互不阻塞；元素移动进出队列，不复制
+ * 节点从 SlabPool 分配，稳定运行时不再申请内存
+ * @code {.cpp}
+ * MpscQueue<Event> q;
+ * q.push(std::move(e));     // 任意线程
+ * Event out;
+ * while(q.pop(out)) { ... } // 只能在一个线程中调用
+ * @endcode
+ * @note pop 返回 false 不代表队列一定为空，生产者可能正处在 push 的中间，
+ *       需要由生产者在 push 之后另行通知消费者
+ */
+namespace shochu {
+
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {
+        this->stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    ~MpscQueue() {
+        T v;
+        while(this->pop(v)) {
+        }
+    }
+
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        this->pushNode(new ValueNode(std::forward<Args>(args)...));
+    }
+    void push(T&& v) {
+        this->emplace(std::move(v));
+    }
+    void push(const T& v) {
+        this->emplace(v);
+    }
+
+    // 只能由消费者线程调用
+    bool pop(T& out) {
+        Node* t = this->tail;
+        Node* next = t->next.load(std::memory_order_acquire);
+        if(t == &this->stub) {
+            if(!next) {
+                return false;
+            }
+            this->tail = next;
+            t = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if(!next) {
+            if(t != this->head.load(std::memory_order_acquire)) {
+                // 有生产者已经交换了 head 但还没有链接上
+                return false;
+            }
+            // t 是最后一个节点，放回 stub 后才能取出 t
+            this->pushNode(&this->stub);
+            next = t->next.load(std::memory_order_acquire);
+            if(!next) {
+                return false;
+            }
+        }
+        this->tail = next;
+        ValueNode* n = static_cast<ValueNode*>(t);
+        out = std::move(n->value);
+        delete n;
+        return true;
+    }
+
+    // 只能由消费者线程调用
+    bool empty() const {
+        Node* t = this->tail;
+        return t == &this->stub && !t->next.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next;
+    };
+    struct ValueNode : Node {
+        template<typename... Args>
+        explicit ValueNode(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+        static void* operator new(size_t n) {
+            if constexpr (alignof(ValueNode) > alignof(std::max_align_t)) {
+                return ::operator new(n, std::align_val_t(alignof(ValueNode)));
+            }
+            else {
+                return SlabPool<sizeof(ValueNode)>::allocate();
+            }
+        }
+        static void operator delete(void* p) {
+            if constexpr (alignof(ValueNode) > alignof(std::max_align_t)) {
+                ::operator delete(p, std::align_val_t(alignof(ValueNode)));
+            }
+            else {
+                SlabPool<sizeof(ValueNode)>::deallocate(p);
+            }
+        }
+
+        T value;
+    };
+
+    void pushNode(Node* n) {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = this->head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    // 生产者写入 head，消费者独占 tail，分开放在不同的缓存行
+    alignas(64) std::atomic<Node*> head;
+    alignas(64) Node* tail;
+    Node stub;
+};
+
+}
+
+#endif // _MPSC_QUEUE_H_
@@ -0,0 +1,418 @@
+#include "shmBridge.hpp"
+
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace {
+
+std::system_error lastError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+// 共享内存中的 futex 不能用 std::atomic::wait，它只在进程内有效
+void futexWait(std::atomic<uint32_t>* addr, uint32_t v) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, v, nullptr, nullptr, 0);
+}
+void futexWake(std::atomic<uint32_t>* addr) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+uint64_t topicKey(const std::string& name) {
+    // FNV-1a，各进程对同名 topic 算出相同的键
+    uint64_t v = 14695981039346656037ull;
+    for(unsigned char c : name) {
+        v = (v ^ c) * 1099511628211ull;
+    }
+    return v;
+}
+
+constexpr size_t alignUp(size_t n, size_t a) {
+    return (n + a - 1) / a * a;
+}
+
+}
+
+// 共享内存中的广播环形缓冲区
+// 每个槽位是一个顺序锁：写入序号 s 时 ver 先为 2s+1，写完后为 2s+2，
+// 读取方复制后再检查 ver，不变才说明复制的内容完整
+// 每个读线程占一个读者槽位，休眠时置位 waitingMask 中对应的位，写入方只在有位时唤醒；
+// 读线程所在进程休眠时退出留下的位，由之后连接或休眠的读线程回收
+class shochu::ShmBridge::Ring {
+public:
+    // 写入方或读取方卡住超过该时长时，视为所在进程已经退出
+    static constexpr std::chrono::milliseconds StallTimeout{1000};
+
+    Ring(const std::string& name, const ShmBridgeOption& option) : base(nullptr), size(0) {
+        std::random_device rd;
+        do {
+            this->self = rd();
+        } while(this->self == 0);
+
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        bool isCreate = fd >= 0;
+        if(!isCreate) {
+            if(errno != EEXIST || (fd = ::shm_open(name.c_str(), O_RDWR, 0)) < 0) {
+                throw lastError(name);
+            }
+        }
+
+        if(isCreate) {
+            size_t cap = std::bit_ceil(std::max<size_t>(option.capacity, 2));
+            size_t stride = alignUp(sizeof(Slot) + option.maxPayloadSize, 64);
+            this->size = HeaderSize + cap * stride;
+            if(::ftruncate(fd, this->size) != 0) {
+                auto e = lastError(name);
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                throw e;
+            }
+        }
+        else {
+            // 创建方可能还没有设置大小
+            auto deadline = std::chrono::steady_clock::now() + StallTimeout;
+            struct stat st;
+            while(::fstat(fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            this->size = st.st_size;
+            if(this->size < HeaderSize) {
+                ::close(fd);
+                throw std::runtime_error("shared memory " + name + " is not initialized");
+            }
+        }
+
+        void* p = ::mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) {
+            throw lastError(name);
+        }
+        this->base = static_cast<char*>(p);
+        this->shared = reinterpret_cast<Shared*>(this->base);
+
+        if(isCreate) {
+            new (this->shared) Shared;
+            this->shared->capacity = (this->size - HeaderSize) / alignUp(sizeof(Slot) + option.maxPayloadSize, 64);
+            this->shared->stride = alignUp(sizeof(Slot) + option.maxPayloadSize, 64);
+            this->shared->maxPayloadSize = option.maxPayloadSize;
+            this->shared->magic.store(Magic, std::memory_order_release);
+        }
+        else {
+            auto deadline = std::chrono::steady_clock::now() + StallTimeout;
+            while(this->shared->magic.load(std::memory_order_acquire) != Magic && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            if(this->shared->magic.load(std::memory_order_acquire) != Magic
+               || HeaderSize + this->shared->capacity * this->shared->stride != this->size) {
+                ::munmap(this->base, this->size);
+                throw std::runtime_error("shared memory " + name + " is not a message bridge");
+            }
+        }
+
+        this->reader = this->attach();
+        if(this->reader < 0) {
+            ::munmap(this->base, this->size);
+            throw std::runtime_error("shared memory " + name + " has too many readers");
+        }
+        this->lastReap = std::chrono::steady_clock::now();
+    }
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    ~Ring() {
+        this->shared->waitingMask.fetch_and(~(uint64_t(1) << this->reader));
+        this->shared->readers[this->reader].store(0, std::memory_order_release);
+        ::munmap(this->base, this->size);
+    }
+
+    uint32_t origin() const {
+        return this->self;
+    }
+    size_t maxPayloadSize() const {
+        return this->shared->maxPayloadSize;
+    }
+
+    void publish(uint64_t key, const void* p, uint32_t n) {
+        uint64_t s = this->shared->claimSeq.fetch_add(1, std::memory_order_relaxed);
+        Slot* slot = this->slotAt(s);
+        uint64_t v = slot->ver.load(std::memory_order_acquire);
+        auto stallStart = std::chrono::steady_clock::time_point::min();
+        while(true) {
+            if(v >= 2 * s + 1) {
+                // 卡住太久，槽位已经被下一圈的写入方占用，读取方会把它计为丢失
+                return;
+            }
+            if((v & 1) && !this->isStalled(stallStart)) {
+                // 上一圈的写入方还没写完
+                std::this_thread::yield();
+                v = slot->ver.load(std::memory_order_acquire);
+                continue;
+            }
+            if(slot->ver.compare_exchange_weak(v, 2 * s + 1, std::memory_order_acquire, std::memory_order_acquire)) {
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->key = key;
+        slot->origin = this->self;
+        slot->size = n;
+        std::memcpy(reinterpret_cast<char*>(slot + 1), p, n);
+        uint64_t busy = 2 * s + 1;
+        slot->ver.compare_exchange_strong(busy, 2 * s + 2, std::memory_order_release, std::memory_order_relaxed);
+
+        // 与读线程中增加 waitingNum 后检查槽位配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(this->shared->waitingMask.load(std::memory_order_relaxed)) {
+            this->shared->wakeSeq.fetch_add(1, std::memory_order_release);
+            futexWake(&this->shared->wakeSeq);
+        }
+    }
+
+    enum ReadResult {
+        Read,
+        Empty,
+        Busy,   // 写入方还没写完
+        Lost
+    };
+    // 读取序号 s 的消息，成功时 s 加一；内容被覆盖时把 s 移到仍然有效的最旧序号，lost 为跳过的条数
+    ReadResult read(uint64_t& s, uint64_t& key, uint32_t& origin, std::vector<char>& buf, uint64_t& lost) {
+        Slot* slot = this->slotAt(s);
+        uint64_t v = slot->ver.load(std::memory_order_acquire);
+        if(v == 2 * s + 2) {
+            key = slot->key;
+            origin = slot->origin;
+            uint32_t n = std::min<uint32_t>(slot->size, this->shared->maxPayloadSize);
+            buf.resize(n);
+            std::memcpy(buf.data(), reinterpret_cast<const char*>(slot + 1), n);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot->ver.load(std::memory_order_relaxed) == v) {
+                ++s;
+                this->stallStart = std::chrono::steady_clock::time_point::min();
+                return Read;
+            }
+        }
+        else if(v <= 2 * s + 1) {
+            if(s >= this->shared->claimSeq.load(std::memory_order_acquire)) {
+                this->stallStart = std::chrono::steady_clock::time_point::min();
+                return Empty;
+            }
+            if(!this->isStalled(this->stallStart)) {
+                return Busy;
+            }
+            this->stallStart = std::chrono::steady_clock::time_point::min();
+            lost = 1;
+            ++s;
+            return Lost;
+        }
+
+        // 被下一圈覆盖
+        uint64_t c = this->shared->claimSeq.load(std::memory_order_acquire);
+        uint64_t oldest = std::max(s + 1, c > this->shared->capacity ? c - this->shared->capacity : 0);
+        lost = oldest - s;
+        s = oldest;
+        return Lost;
+    }
+
+    uint64_t tail() const {
+        return this->shared->claimSeq.load(std::memory_order_acquire);
+    }
+
+    // 没有新消息时休眠，直到有写入或 wake
+    void wait(uint64_t s) {
+        auto now = std::chrono::steady_clock::now();
+        if(now - this->lastReap > StallTimeout) {
+            this->lastReap = now;
+            this->reap();
+        }
+        uint64_t bit = uint64_t(1) << this->reader;
+        uint32_t seq = this->shared->wakeSeq.load(std::memory_order_acquire);
+        this->shared->waitingMask.fetch_or(bit);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(s >= this->shared->claimSeq.load(std::memory_order_relaxed)) {
+            futexWait(&this->shared->wakeSeq, seq);
+        }
+        this->shared->waitingMask.fetch_and(~bit);
+    }
+    void wake() {
+        this->shared->wakeSeq.fetch_add(1, std::memory_order_release);
+        futexWake(&this->shared->wakeSeq);
+    }
+
+private:
+    static constexpr uint32_t Magic = 0x4d514253;
+    static constexpr int MaxReaderNum = 64;
+    // 正在回收的读者槽位，期间其他读线程不能占用
+    static constexpr uint32_t ReapingPid = UINT32_MAX;
+
+    struct Shared {
+        std::atomic<uint32_t> magic{0};
+        uint32_t maxPayloadSize = 0;
+        uint64_t capacity = 0;
+        uint64_t stride = 0;
+        alignas(64) std::atomic<uint64_t> claimSeq{0};
+        alignas(64) std::atomic<uint32_t> wakeSeq{0};
+        // 第 i 位表示 readers[i] 的读线程正在休眠
+        std::atomic<uint64_t> waitingMask{0};
+        // 占用读者槽位的进程号，0为空闲
+        std::atomic<uint32_t> readers[MaxReaderNum]{};
+    };
+    // 后面紧跟负载
+    struct Slot {
+        std::atomic<uint64_t> ver;
+        uint64_t key;
+        uint32_t origin;
+        uint32_t size;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+    static constexpr size_t HeaderSize = alignUp(sizeof(Shared), 64);
+
+    char* base;
+    size_t size;
+    Shared* shared;
+    uint32_t self;
+    int reader;
+    // 只由读线程使用
+    std::chrono::steady_clock::time_point stallStart;
+    std::chrono::steady_clock::time_point lastReap;
+
+    Slot* slotAt(uint64_t s) const {
+        return reinterpret_cast<Slot*>(this->base + HeaderSize + (s & (this->shared->capacity - 1)) * this->shared->stride);
+    }
+
+    static bool isDead(uint32_t pid) {
+        return pid != 0 && pid != ReapingPid && ::kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+    }
+
+    // 占用一个空闲或所在进程已经退出的读者槽位，没有时返回 -1
+    int attach() {
+        uint32_t self = static_cast<uint32_t>(::getpid());
+        for(int i=0;i<MaxReaderNum;++i) {
+            uint32_t pid = this->shared->readers[i].load(std::memory_order_acquire);
+            if((pid == 0 || isDead(pid)) && this->shared->readers[i].compare_exchange_strong(pid, self)) {
+                // 之前的读线程可能在休眠时退出，留下了位
+                this->shared->waitingMask.fetch_and(~(uint64_t(1) << i));
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // 清除所在进程已经退出的读线程留下的位，否则之后每次写入都要唤醒
+    void reap() {
+        for(int i=0;i<MaxReaderNum;++i) {
+            uint32_t pid = this->shared->readers[i].load(std::memory_order_acquire);
+            // 先占住槽位再清位，避免清掉刚连接的读线程休眠时置的位
+            if(isDead(pid) && this->shared->readers[i].compare_exchange_strong(pid, ReapingPid)) {
+                this->shared->waitingMask.fetch_and(~(uint64_t(1) << i));
+                this->shared->readers[i].store(0, std::memory_order_release);
+            }
+        }
+    }
+
+    static bool isStalled(std::chrono::steady_clock::time_point& start) {
+        auto now = std::chrono::steady_clock::now();
+        if(start == std::chrono::steady_clock::time_point::min()) {
+            start = now;
+        }
+        return now - start > StallTimeout;
+    }
+};
+
+shochu::ShmBridge::ShmBridge(const std::string& name, const ShmBridgeOption& option, MessageQueue* mq) :
+    mq(mq),
+    ring(std::make_shared<Ring>(name, option)),
+    droppedNum(0),
+    isQuit(false) {
+    this->th = std::thread(&ShmBridge::readThread, this);
+}
+
+shochu::ShmBridge::~ShmBridge() {
+    {
+        std::lock_guard<std::mutex> l(this->m);
+        for(auto& it : this->mirrors) {
+            this->mq->unregisterSubscripter(it.second.subID);
+        }
+    }
+    this->isQuit = true;
+    this->ring->wake();
+    this->th.join();
+}
+
+void shochu::ShmBridge::unlink(const std::string& name) {
+    ::shm_unlink(name.c_str());
+}
+
+void shochu::ShmBridge::addMirror(TopicID topic, size_t size, MakeFunc make, PayloadFunc payload) {
+    if(size > this->ring->maxPayloadSize()) {
+        throw std::invalid_argument("payload of " + topicName(topic) + " is larger than the bridge slot");
+    }
+    uint64_t key = topicKey(topicName(topic));
+    std::lock_guard<std::mutex> l(this->m);
+    if(this->mirrors.count(key)) {
+        return;
+    }
+    // 只转发本进程投递的消息，收到的消息 origin 不为0
+    int id = this->mq->subscribeMessage(topic, [r = this->ring, key, size, payload](const MessageBase& m) {
+        if(m.origin() != 0) {
+            return;
+        }
+        if(const void* p = payload(m)) {
+            r->publish(key, p, static_cast<uint32_t>(size));
+        }
+    });
+    this->mirrors.emplace(key, Mirror{topic, size, make, id});
+}
+
+void shochu::ShmBridge::readThread() {
+    constexpr int SpinNum = 64;
+    // 只接收打开之后写入的消息
+    uint64_t s = this->ring->tail();
+    uint64_t key = 0;
+    uint32_t origin = 0;
+    uint64_t lost = 0;
+    std::vector<char> buf;
+    int spin = 0;
+    while(!this->isQuit) {
+        switch(this->ring->read(s, key, origin, buf, lost)) {
+        case Ring::Read:
+            spin = 0;
+            if(origin != this->ring->origin()) {
+                std::lock_guard<std::mutex> l(this->m);
+                auto it = this->mirrors.find(key);
+                if(it != this->mirrors.end() && it->second.size == buf.size()) {
+                    this->mq->post(it->second.make(origin, it->second.topic, buf.data()));
+                }
+            }
+            break;
+        case Ring::Busy:
+            std::this_thread::yield();
+            break;
+        case Ring::Lost:
+            this->droppedNum.fetch_add(lost, std::memory_order_relaxed);
+            break;
+        case Ring::Empty:
+            if(spin < SpinNum) {
+                ++spin;
+                std::this_thread::yield();
+            }
+            else {
+                this->ring->wait(s);
+            }
+            break;
+        }
+    }
+}
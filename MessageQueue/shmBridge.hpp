@@ -0,0 +1,110 @@
+#ifndef _SHM_BRIDGE_H_
+#define _SHM_BRIDGE_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+
+#include "messageQueue.h"
+
+/**
+ * @brief 通过共享内存在同一台机器的多个进程之间转发 topic
+ * 连接同一个 name 的进程共用一个环形缓冲区，mirror 过的 topic 中本进程投递的消息
+ * 按字节复制进缓冲区，其他进程的读线程取出后投递到各自的消息队列；
+ * 写入和读取都只有原子操作，只有读线程休眠时才用 futex 唤醒
+ * @code {.cpp}
+ * ShmBridge bridge("/app-bus");
+ * bridge.mirror<Sample>("sample");
+ * MessageQueue::getInstance()->post("sample", Sample{...}); // 其他进程中 subscribe<Sample>("sample") 的订阅者也会收到
+ * @endcode
+ * @note 缓冲区满时覆盖最旧的消息，读得太慢的进程丢失被覆盖的消息并计入 getDroppedNum，
+ *       不会阻塞其他进程
+ * @note 从其他进程收到的消息不再转发，进程之间只转发一跳，不会形成回路
+ * @note 各进程按 topic 名称和负载大小匹配，同名 topic 在各进程中应使用相同的类型
+ * @note 每个共享内存最多同时连接 64 个 ShmBridge，超过时构造抛出 std::runtime_error；
+ *       各进程应在同一个 PID 命名空间中，以便回收已退出进程占用的读者槽位
+ * @note 只支持 Linux
+ */
+namespace shochu {
+
+struct ShmBridgeOption {
+    // 缓冲区的槽位数，向上取到2的幂，只在创建共享内存时使用
+    size_t capacity = 1 << 14;
+    // 每条消息负载的最大字节数，只在创建共享内存时使用
+    size_t maxPayloadSize = 256;
+};
+
+class ShmBridge {
+public:
+    // 打开名为 name 的共享内存，不存在时按 option 创建，失败时抛出 std::system_error
+    explicit ShmBridge(const std::string& name, const ShmBridgeOption& option = ShmBridgeOption(), MessageQueue* mq = MessageQueue::getInstance());
+    ShmBridge(const ShmBridge&) = delete;
+    ShmBridge& operator=(const ShmBridge&) = delete;
+    ~ShmBridge();
+
+    // 在进程之间转发 topic 中负载类型为 T 的消息，负载按字节复制，因此 T 必须可以平凡复制
+    // sizeof(T) 超过共享内存的 maxPayloadSize 时抛出 std::invalid_argument
+    template<typename T>
+    requires std::is_trivially_copyable_v<T>
+    void mirror(TopicID topic) {
+        this->addMirror(topic, sizeof(T),
+            [](uint32_t origin, TopicID topic, const void* p) {
+                return makeMessageFrom<T>(origin, topic, *static_cast<const T*>(p));
+            },
+            [](const MessageBase& m) -> const void* {
+                return m.get<T>();
+            });
+    }
+    template<typename T>
+    requires std::is_trivially_copyable_v<T>
+    void mirror(const std::string& topic) {
+        this->mirror<T>(internTopic(topic));
+    }
+
+    // 因读得太慢被覆盖或写入方中途退出而丢失的消息数
+    uint64_t getDroppedNum() const {
+        return this->droppedNum.load(std::memory_order_relaxed);
+    }
+
+    // 删除共享内存的名字，已经打开的进程不受影响
+    static void unlink(const std::string& name);
+
+private:
+    class Ring;
+
+    using MakeFunc = MessageRef (*)(uint32_t origin, TopicID topic, const void* p);
+    using PayloadFunc = const void* (*)(const MessageBase& m);
+
+    struct Mirror {
+        TopicID topic;
+        size_t size;
+        MakeFunc make;
+        int subID;
+    };
+
+    MessageQueue* mq;
+    // 订阅者的回调持有 ring，取消订阅后回调仍可能在分发线程中执行一次
+    std::shared_ptr<Ring> ring;
+    std::atomic<uint64_t> droppedNum;
+
+    // 键为 topic 名称的哈希，各进程相同
+    std::mutex m;
+    std::unordered_map<uint64_t, Mirror> mirrors;
+
+    std::atomic<bool> isQuit;
+    std::thread th;
+
+    void addMirror(TopicID topic, size_t size, MakeFunc make, PayloadFunc payload);
+    // 取出其他进程写入的消息投递到本进程的消息队列
+    void readThread();
+};
+
+}
+
+#endif // _SHM_BRIDGE_H_
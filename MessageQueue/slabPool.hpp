@@ -0,0 +1,123 @@
+#ifndef _SLAB_POOL_H_
+#define _SLAB_POOL_H_
+
+#include <new>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @brief 固定大小内存块的池
+ * 每个线程缓存一批空闲块，分配和释放只访问本线程缓存；
+ * 缓存过多时整批还给全局池，用完时从全局池整批取回或新切一块 slab，
+ * 因此在一个线程分配、另一个线程释放时平均每 BatchNum 次才加一次锁
+ * @code {.cpp}
+ * void* p = SlabPool<sizeof(Node)>::allocate();
+ * SlabPool<sizeof(Node)>::deallocate(p);
+ * @endcode
+ * @note 申请的 slab 不会还给系统
+ */
+namespace shochu {
+
+template<size_t Size>
+class SlabPool {
+public:
+    static void* allocate() {
+        Cache& c = local();
+        if(!c.head) {
+            refill(c);
+        }
+        Node* n = c.head;
+        c.head = n->next;
+        --c.num;
+        return n;
+    }
+
+    static void deallocate(void* p) {
+        Cache& c = local();
+        Node* n = static_cast<Node*>(p);
+        n->next = c.head;
+        c.head = n;
+        if(++c.num >= BatchNum * 2) {
+            flush(c, BatchNum);
+        }
+    }
+
+private:
+    struct Node {
+        Node* next;
+    };
+
+    static constexpr size_t Align = alignof(std::max_align_t);
+    static constexpr size_t BlockSize = ((Size > sizeof(Node) ? Size : sizeof(Node)) + Align - 1) / Align * Align;
+    // 线程缓存与全局池之间每次移动的块数，也是每个 slab 的块数
+    static constexpr size_t BatchNum = 64;
+
+    struct Cache {
+        Node* head = nullptr;
+        size_t num = 0;
+
+        ~Cache() {
+            flush(*this, this->num);
+        }
+    };
+    struct Global {
+        std::mutex m;
+        // 每项是一条链表及其长度
+        std::vector<std::pair<Node*, size_t>> lists;
+    };
+
+    static Cache& local() {
+        thread_local Cache c;
+        return c;
+    }
+    static Global& global() {
+        // 不析构，其他静态对象析构时仍可以释放
+        static Global* g = new Global;
+        return *g;
+    }
+
+    static void refill(Cache& c) {
+        Global& g = global();
+        {
+            std::lock_guard<std::mutex> l(g.m);
+            if(!g.lists.empty()) {
+                c.head = g.lists.back().first;
+                c.num = g.lists.back().second;
+                g.lists.pop_back();
+                return;
+            }
+        }
+        char* slab = static_cast<char*>(::operator new(BlockSize * BatchNum));
+        for(size_t i=0;i<BatchNum;++i) {
+            Node* n = reinterpret_cast<Node*>(slab + i * BlockSize);
+            n->next = i + 1 < BatchNum ? reinterpret_cast<Node*>(slab + (i + 1) * BlockSize) : nullptr;
+        }
+        c.head = reinterpret_cast<Node*>(slab);
+        c.num = BatchNum;
+    }
+
+    // 从缓存头部取下 n 块还给全局池
+    static void flush(Cache& c, size_t n) {
+        if(n == 0) {
+            return;
+        }
+        Node* first = c.head;
+        Node* last = first;
+        for(size_t i=1;i<n;++i) {
+            last = last->next;
+        }
+        c.head = last->next;
+        c.num -= n;
+        last->next = nullptr;
+
+        Global& g = global();
+        std::lock_guard<std::mutex> l(g.m);
+        g.lists.emplace_back(first, n);
+    }
+};
+
+}
+
+#endif // _SLAB_POOL_H_
@@ -0,0 +1,110 @@
+#ifndef _CANCEL_H_
+#define _CANCEL_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief 协作式取消
+ * @code {.cpp}
+ * shochu::CancelSource src;
+ * ThreadPool::TaskOption option;
+ * option.token = src.token();
+ * ThreadPool::getInstance()->addTask(option, []() {
+ *     while(!shochu::CancelToken::current().isCancelled()) { ... }   // 长任务轮询
+ * });
+ *
+ * {
+ *     shochu::CancelScope scope(src.token());   // 作用域内投递的任务都带上 src 的令牌
+ *     ThreadPool::getInstance()->addTask(...);
+ * }
+ * src.cancel();   // 尚未开始的任务不再执行，正在执行的任务可以通过轮询退出
+ * @endcode
+ * @note 带令牌的任务执行时该令牌成为当前令牌，任务内部投递的任务同样会被一起取消
+ * @note 线程池内部的后续任务（协程恢复、Future 回调等）用 CancelToken::none() 投递，不受当前令牌影响
+ */
+namespace shochu {
+
+class CancelToken;
+
+class CancelSource {
+public:
+    CancelSource() : state(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() {
+        this->state->store(true, std::memory_order_release);
+    }
+    bool isCancelled() const {
+        return this->state->load(std::memory_order_acquire);
+    }
+    CancelToken token() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> state;
+};
+
+// 不持有令牌时永远不会被取消
+class CancelToken {
+public:
+    CancelToken() {}
+
+    bool valid() const {
+        return this->state != nullptr;
+    }
+    // 是否为 none()
+    bool isNone() const {
+        return this->isExplicitNone;
+    }
+    bool isCancelled() const {
+        return this->state && this->state->load(std::memory_order_acquire);
+    }
+
+    // 当前线程的令牌，即正在执行的任务或最内层 CancelScope 的令牌
+    static const CancelToken& current() {
+        return local();
+    }
+
+    // 显式的空令牌，投递时用它表示不带令牌，也不继承当前令牌
+    static CancelToken none() {
+        CancelToken token;
+        token.isExplicitNone = true;
+        return token;
+    }
+
+private:
+    friend class CancelSource;
+    friend class CancelScope;
+
+    explicit CancelToken(std::shared_ptr<std::atomic<bool>> s) : state(std::move(s)) {}
+
+    static CancelToken& local() {
+        thread_local CancelToken token;
+        return token;
+    }
+
+    std::shared_ptr<std::atomic<bool>> state;
+    bool isExplicitNone = false;
+};
+
+inline CancelToken CancelSource::token() const {
+    return CancelToken(this->state);
+}
+
+// 在作用域内替换当前线程的令牌，退出时恢复
+class CancelScope {
+public:
+    explicit CancelScope(CancelToken token) : prev(std::exchange(CancelToken::local(), std::move(token))) {}
+    CancelScope(const CancelScope&) = delete;
+    CancelScope& operator=(const CancelScope&) = delete;
+    ~CancelScope() {
+        CancelToken::local() = std::move(this->prev);
+    }
+
+private:
+    CancelToken prev;
+};
+
+}
+
+#endif // _CANCEL_H_
@@ -0,0 +1,428 @@
+#ifndef _COROUTINE_H_
+#define _COROUTINE_H_
+
+#include <new>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <coroutine>
+#include <type_traits>
+
+#include "threadPool.hpp"
+
+/**
+ * @brief 基于线程池的协程
+ * @code {.cpp}
+ * shochu::CoTask<int> load(ThreadPool* pool) {
+ *     co_await pool->schedule();                       // 之后在工作线程中执行
+ *     int a = co_await pool->submit([]() { return 1; }); // 等待 Future
+ *     co_await shochu::sleepFor(std::chrono::milliseconds(10));
+ *     shochu::Event e = co_await MessageQueue::getInstance()->nextEvent("topic");
+ *     co_return a;
+ * }
+ * int v = shochu::syncWait(load(ThreadPool::getInstance()));
+ * @endcode
+ * @note CoTask 是惰性的，被 co_await 或交给 syncWait/toFuture 时才开始执行
+ * @note 协程帧从线程局部的空闲链表中分配，稳定运行时挂起和恢复不申请内存
+ * @note 等待 Future、定时器和消息时，恢复在线程池中进行
+ */
+namespace shochu {
+
+// 协程帧分配器，按 64 字节分级缓存释放的内存，超过 2KB 的直接使用 operator new
+// 内存可以在分配线程以外的线程释放，进入释放线程的缓存
+class FrameAllocator {
+public:
+    static void* allocate(size_t n) {
+        size_t c = sizeClass(n);
+        if(c >= ClassNum) {
+            return ::operator new(n);
+        }
+        Cache& cache = local();
+        if(FreeNode* node = cache.head[c]) {
+            cache.head[c] = node->next;
+            --cache.num[c];
+            return node;
+        }
+        return ::operator new((c + 1) * Granularity);
+    }
+
+    static void deallocate(void* p, size_t n) {
+        size_t c = sizeClass(n);
+        Cache& cache = local();
+        if(c >= ClassNum || cache.num[c] >= MaxCacheNum) {
+            ::operator delete(p);
+            return;
+        }
+        FreeNode* node = static_cast<FreeNode*>(p);
+        node->next = cache.head[c];
+        cache.head[c] = node;
+        ++cache.num[c];
+    }
+
+private:
+    static constexpr size_t Granularity = 64;
+    static constexpr size_t ClassNum = 32;
+    // 每个线程每级最多缓存的块数
+    static constexpr size_t MaxCacheNum = 256;
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+    struct Cache {
+        FreeNode* head[ClassNum] = {};
+        size_t num[ClassNum] = {};
+
+        ~Cache() {
+            for(FreeNode* node : this->head) {
+                while(node) {
+                    FreeNode* next = node->next;
+                    ::operator delete(node);
+                    node = next;
+                }
+            }
+        }
+    };
+
+    static size_t sizeClass(size_t n) {
+        return (n + Granularity - 1) / Granularity - 1;
+    }
+    static Cache& local() {
+        thread_local Cache cache;
+        return cache;
+    }
+};
+
+// 协程的 promise 从 FrameAllocator 分配帧
+struct FramePromise {
+    static void* operator new(size_t n) {
+        return FrameAllocator::allocate(n);
+    }
+    static void operator delete(void* p, size_t n) {
+        FrameAllocator::deallocate(p, n);
+    }
+};
+
+template<typename T = void>
+class CoTask;
+
+template<typename T>
+class CoTaskPromise : public FramePromise {
+public:
+    CoTask<T> get_return_object() noexcept;
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    // 结束时转到等待者继续执行
+    struct FinalAwaiter {
+        bool await_ready() noexcept {
+            return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<CoTaskPromise> h) noexcept {
+            std::coroutine_handle<> cont = h.promise().cont;
+            return cont ? cont : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+
+    template<typename V = T>
+    requires std::convertible_to<V, T>
+    void return_value(V&& v) {
+        this->value.emplace(std::forward<V>(v));
+    }
+    void unhandled_exception() {
+        this->err = std::current_exception();
+    }
+
+    T result() {
+        if(this->err) {
+            std::rethrow_exception(this->err);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*this->value);
+        }
+    }
+
+    std::coroutine_handle<> cont;
+    std::optional<FutureValue<T>> value;
+    std::exception_ptr err;
+};
+
+template<>
+class CoTaskPromise<void> : public FramePromise {
+public:
+    CoTask<void> get_return_object() noexcept;
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept {
+            return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<CoTaskPromise> h) noexcept {
+            std::coroutine_handle<> cont = h.promise().cont;
+            return cont ? cont : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+
+    void return_void() noexcept {}
+    void unhandled_exception() {
+        this->err = std::current_exception();
+    }
+
+    void result() {
+        if(this->err) {
+            std::rethrow_exception(this->err);
+        }
+    }
+
+    std::coroutine_handle<> cont;
+    std::exception_ptr err;
+};
+
+// 协程任务，co_await 时开始执行并在结束后恢复等待者，结果或异常传给等待者
+template<typename T>
+class CoTask {
+public:
+    using promise_type = CoTaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    CoTask() noexcept : h(nullptr) {}
+    CoTask(CoTask&& o) noexcept : h(o.h) {
+        o.h = nullptr;
+    }
+    CoTask& operator=(CoTask&& o) noexcept {
+        if(this != &o) {
+            if(this->h) {
+                this->h.destroy();
+            }
+            this->h = o.h;
+            o.h = nullptr;
+        }
+        return *this;
+    }
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask() {
+        if(this->h) {
+            this->h.destroy();
+        }
+    }
+
+    bool valid() const {
+        return this->h != nullptr;
+    }
+
+    struct Awaiter {
+        Handle h;
+
+        bool await_ready() noexcept {
+            return !this->h || this->h.done();
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept {
+            this->h.promise().cont = cont;
+            return this->h;
+        }
+        T await_resume() {
+            return this->h.promise().result();
+        }
+    };
+    Awaiter operator co_await() && noexcept {
+        return Awaiter{this->h};
+    }
+    Awaiter operator co_await() & noexcept {
+        return Awaiter{this->h};
+    }
+
+private:
+    friend class CoTaskPromise<T>;
+
+    explicit CoTask(Handle h) : h(h) {}
+
+    Handle h;
+};
+
+template<typename T>
+CoTask<T> CoTaskPromise<T>::get_return_object() noexcept {
+    return CoTask<T>(std::coroutine_handle<CoTaskPromise<T>>::from_promise(*this));
+}
+inline CoTask<void> CoTaskPromise<void>::get_return_object() noexcept {
+    return CoTask<void>(std::coroutine_handle<CoTaskPromise<void>>::from_promise(*this));
+}
+
+// 在线程池中恢复协程的任务
+// 没有执行就被销毁（被 DiscardOldest 挤掉、Cancel 方式 shutdown 时被丢弃等）时在析构中恢复，
+// 保证协程不会永远挂起
+class ResumeTask {
+public:
+    explicit ResumeTask(std::coroutine_handle<> h) noexcept : h(h) {}
+    ResumeTask(ResumeTask&& o) noexcept : h(std::exchange(o.h, nullptr)) {}
+    ResumeTask& operator=(ResumeTask&&) = delete;
+    ~ResumeTask() {
+        if(this->h) {
+            std::exchange(this->h, nullptr).resume();
+        }
+    }
+
+    void operator()() {
+        std::exchange(this->h, nullptr).resume();
+    }
+    // 投递失败时由调用方自行恢复，放弃句柄
+    void release() noexcept {
+        this->h = nullptr;
+    }
+
+private:
+    std::coroutine_handle<> h;
+};
+
+// 切换到线程池中继续执行，见 ThreadPool::schedule
+class ScheduleAwaiter {
+public:
+    explicit ScheduleAwaiter(ThreadPool* pool) : pool(pool) {}
+
+    bool await_ready() noexcept {
+        return false;
+    }
+    // 线程池已停止时不挂起，在当前线程继续执行
+    bool await_suspend(std::coroutine_handle<> h) {
+        ResumeTask t(h);
+        if(this->pool->addTask(CancelToken::none(), std::move(t))) {
+            return true;
+        }
+        t.release();
+        return false;
+    }
+    void await_resume() noexcept {}
+
+private:
+    ThreadPool* pool;
+};
+
+inline ScheduleAwaiter ThreadPool::schedule() {
+    return ScheduleAwaiter(this);
+}
+
+// 挂起 d 后在线程池中继续执行，不占用线程
+class SleepAwaiter {
+public:
+    SleepAwaiter(std::chrono::steady_clock::duration d, ThreadPool* pool) : d(d), pool(pool) {}
+
+    bool await_ready() noexcept {
+        return false;
+    }
+    // 线程池已停止时不挂起，不等待直接继续执行
+    bool await_suspend(std::coroutine_handle<> h) {
+        ResumeTask t(h);
+        if(this->pool->scheduleAfter(this->d, std::move(t)).valid()) {
+            return true;
+        }
+        t.release();
+        return false;
+    }
+    void await_resume() noexcept {}
+
+private:
+    std::chrono::steady_clock::duration d;
+    ThreadPool* pool;
+};
+
+inline SleepAwaiter sleepFor(std::chrono::steady_clock::duration d, ThreadPool* pool = ThreadPool::getInstance()) {
+    return SleepAwaiter(d, pool);
+}
+
+// co_await Future，完成后在线程池中继续执行，结果为 get() 的返回值
+template<typename T>
+class FutureAwaiter {
+public:
+    explicit FutureAwaiter(Future<T>& f) : f(f) {}
+
+    bool await_ready() {
+        return this->f.isReady();
+    }
+    void await_suspend(std::coroutine_handle<> h) {
+        this->f.state->setCallback(Task(ResumeTask(h)), true);
+    }
+    T await_resume() {
+        return this->f.get();
+    }
+
+private:
+    Future<T>& f;
+};
+
+// Future 是 co_await 表达式中的临时对象时，会一直存活到协程恢复之后
+template<typename T>
+FutureAwaiter<T> operator co_await(Future<T>& f) {
+    return FutureAwaiter<T>(f);
+}
+template<typename T>
+FutureAwaiter<T> operator co_await(Future<T>&& f) {
+    return FutureAwaiter<T>(f);
+}
+
+// 立即开始执行、结束时自行销毁的协程，用于把 CoTask 接到 Future 上
+struct DetachedCoroutine {
+    struct promise_type : FramePromise {
+        DetachedCoroutine get_return_object() noexcept {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+template<typename T>
+DetachedCoroutine runToPromise(CoTask<T> t, Promise<T> p) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(t);
+            p.setValue();
+        }
+        else {
+            p.setValue(co_await std::move(t));
+        }
+    }
+    catch(...) {
+        p.setException(std::current_exception());
+    }
+}
+
+// 在当前线程中开始执行 t，直到第一次挂起，返回的 Future 在 t 结束时完成
+template<typename T>
+Future<T> toFuture(CoTask<T> t) {
+    Promise<T> p;
+    Future<T> res = p.getFuture();
+    runToPromise(std::move(t), std::move(p));
+    return res;
+}
+
+// 阻塞等待 t 结束并返回其结果，用于同步代码调用协程，不能在协程内部调用
+template<typename T>
+T syncWait(CoTask<T> t) {
+    return toFuture(std::move(t)).get();
+}
+
+}
+
+#endif // _COROUTINE_H_
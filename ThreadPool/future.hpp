@@ -0,0 +1,411 @@
+#ifndef _FUTURE_H_
+#define _FUTURE_H_
+
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include <optional>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+#include "task.hpp"
+#include "threadPool.hpp"
+
+/**
+ * @brief 线程池任务的结果
+ * @code {.cpp}
+ * auto f = ThreadPool::getInstance()->submit([](int a, int b) { return a + b; }, 1, 2);
+ * auto g = f.then([](int v) { return std::to_string(v); });   // 在线程池中执行
+ * std::string s = g.get();
+ *
+ * std::vector<Future<int>> fs;
+ * ...
+ * whenAll(std::move(fs)).then([](std::vector<int> vals) { ... });
+ * @endcode
+ * @note Future 和 Promise 共享一个引用计数的状态对象，只申请一次内存
+ * @note get/wait 会阻塞当前线程，在任务内部应使用 then 串联后续操作
+ */
+namespace shochu {
+
+template<typename T>
+class Future;
+template<typename T>
+class Promise;
+
+// void 的结果用 std::monostate 占位
+template<typename T>
+using FutureValue = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template<typename T>
+class FutureState {
+public:
+    FutureState() : refNum(1), status(Pending), contOnPool(false) {}
+
+    void addRef() {
+        this->refNum.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release() {
+        if(this->refNum.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    template<typename... V>
+    void setValue(V&&... v) {
+        this->value.emplace(std::forward<V>(v)...);
+        this->finish();
+    }
+    void setException(std::exception_ptr e) {
+        this->err = e;
+        this->finish();
+    }
+
+    bool isReady() const {
+        return this->status.load(std::memory_order_acquire) == Ready;
+    }
+    void wait() const {
+        while(!this->isReady()) {
+            this->status.wait(Pending, std::memory_order_acquire);
+        }
+    }
+
+    // 设置完成后的回调，onPool 为 true 时投递到线程池，否则在完成的线程中直接执行
+    // 已经完成时立即执行
+    void setCallback(Task&& t, bool onPool) {
+        this->m.lock();
+        if(!this->isReady()) {
+            this->cont = std::move(t);
+            this->contOnPool = onPool;
+            this->m.unlock();
+            return;
+        }
+        this->m.unlock();
+        dispatch(std::move(t), onPool);
+    }
+
+    std::optional<FutureValue<T>> value;
+    std::exception_ptr err;
+
+private:
+    enum : uint32_t {
+        Pending,
+        Ready
+    };
+
+    std::atomic<int> refNum;
+    std::atomic<uint32_t> status;
+
+    std::mutex m;
+    Task cont;
+    bool contOnPool;
+
+    void finish() {
+        this->m.lock();
+        this->status.store(Ready, std::memory_order_release);
+        Task t = std::move(this->cont);
+        bool onPool = this->contOnPool;
+        this->m.unlock();
+
+        this->status.notify_all();
+        if(t) {
+            dispatch(std::move(t), onPool);
+        }
+    }
+
+    // 回调属于等待结果的一方，不受完成线程的当前令牌影响；线程池已停止时直接执行
+    static void dispatch(Task&& t, bool onPool) {
+        if(!onPool || !ThreadPool::getInstance()->addTask(CancelToken::none(), std::move(t))) {
+            t();
+        }
+    }
+};
+
+template<typename T>
+class Future {
+public:
+    Future() : state(nullptr) {}
+    Future(Future&& o) noexcept : state(o.state) {
+        o.state = nullptr;
+    }
+    Future& operator=(Future&& o) noexcept {
+        if(this != &o) {
+            if(this->state) {
+                this->state->release();
+            }
+            this->state = o.state;
+            o.state = nullptr;
+        }
+        return *this;
+    }
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+    ~Future() {
+        if(this->state) {
+            this->state->release();
+        }
+    }
+
+    bool valid() const {
+        return this->state != nullptr;
+    }
+    bool isReady() const {
+        return this->state->isReady();
+    }
+    void wait() const {
+        this->state->wait();
+    }
+
+    // 阻塞直到结果可用，结果被移动给调用方
+    T get() {
+        this->state->wait();
+        if(this->state->err) {
+            std::rethrow_exception(this->state->err);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*this->state->value);
+        }
+    }
+
+    // 结果可用后在线程池中以结果调用 f，返回 f 的结果
+    // 本 Future 被消耗，异常会直接传递给返回的 Future
+    template<typename F>
+    auto then(F&& f) {
+        using R = typename ThenResult<std::decay_t<F>>::type;
+        Promise<R> p;
+        Future<R> res = p.getFuture();
+        this->onReady([p = std::move(p), f = std::forward<F>(f)](Future<T>&& self) mutable {
+            if(self.state->err) {
+                p.setException(self.state->err);
+            }
+            else if constexpr (std::is_void_v<T>) {
+                p.setWith(std::move(f));
+            }
+            else {
+                p.setWith([&]() -> R {
+                    return std::invoke(std::move(f), std::move(*self.state->value));
+                });
+            }
+        }, true);
+        return res;
+    }
+
+private:
+    FutureState<T>* state;
+
+    friend class Promise<T>;
+    template<typename U>
+    friend class Future;
+    template<typename U>
+    friend class FutureAwaiter;
+    template<typename U>
+    friend Future<std::conditional_t<std::is_void_v<U>, void, std::vector<U>>> whenAll(std::vector<Future<U>> fs);
+    template<typename U>
+    friend Future<std::conditional_t<std::is_void_v<U>, size_t, std::pair<size_t, U>>> whenAny(std::vector<Future<U>> fs);
+
+    explicit Future(FutureState<T>* s) : state(s) {}
+
+    template<typename F>
+    struct ThenResult {
+        using type = std::invoke_result_t<F, T>;
+    };
+    template<typename F>
+    requires std::is_void_v<T>
+    struct ThenResult<F> {
+        using type = std::invoke_result_t<F>;
+    };
+
+    // 完成后以就绪的 Future 调用 f(Future<T>&&)，本 Future 被消耗
+    template<typename F>
+    void onReady(F&& f, bool onPool) {
+        FutureState<T>* s = this->state;
+        s->setCallback(Task([self = std::move(*this), f = std::forward<F>(f)]() mutable {
+            f(std::move(self));
+        }), onPool);
+    }
+};
+
+template<typename T>
+class Promise {
+public:
+    Promise() : state(new FutureState<T>), retrieved(false) {}
+    Promise(Promise&& o) noexcept : state(o.state), retrieved(o.retrieved) {
+        o.state = nullptr;
+    }
+    Promise& operator=(Promise&& o) noexcept {
+        if(this != &o) {
+            this->abandon();
+            this->state = o.state;
+            this->retrieved = o.retrieved;
+            o.state = nullptr;
+        }
+        return *this;
+    }
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+    ~Promise() {
+        this->abandon();
+    }
+
+    // 只能调用一次
+    Future<T> getFuture() {
+        if(this->retrieved) {
+            throw std::future_error(std::future_errc::future_already_retrieved);
+        }
+        this->retrieved = true;
+        this->state->addRef();
+        return Future<T>(this->state);
+    }
+
+    template<typename... V>
+    void setValue(V&&... v) {
+        this->state->setValue(std::forward<V>(v)...);
+        this->state->release();
+        this->state = nullptr;
+    }
+    void setException(std::exception_ptr e) {
+        this->state->setException(e);
+        this->state->release();
+        this->state = nullptr;
+    }
+
+    // 以 f() 的返回值或抛出的异常完成
+    template<typename F>
+    void setWith(F&& f) {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                std::invoke(std::forward<F>(f));
+                this->setValue();
+            }
+            else {
+                this->setValue(std::invoke(std::forward<F>(f)));
+            }
+        }
+        catch(...) {
+            if(this->state) {
+                this->setException(std::current_exception());
+            }
+        }
+    }
+
+private:
+    FutureState<T>* state;
+    bool retrieved;
+
+    // 未设置结果就析构时以 broken_promise 完成
+    void abandon() {
+        if(this->state) {
+            this->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+};
+
+// 全部完成后以各自的结果（按输入顺序）完成，任意一个失败则以第一个异常完成
+template<typename T>
+Future<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> whenAll(std::vector<Future<T>> fs) {
+    using R = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+    struct Context {
+        Promise<R> p;
+        std::vector<std::optional<FutureValue<T>>> results;
+        std::atomic<size_t> remainNum;
+        std::atomic<bool> isFailed;
+    };
+
+    auto ctx = std::make_shared<Context>();
+    Future<R> res = ctx->p.getFuture();
+    ctx->results.resize(fs.size());
+    ctx->remainNum = fs.size();
+    ctx->isFailed = false;
+    if(fs.empty()) {
+        ctx->p.setValue();
+        return res;
+    }
+
+    for(size_t i=0;i<fs.size();++i) {
+        fs[i].onReady([ctx, i](Future<T>&& f) {
+            if(f.state->err) {
+                if(!ctx->isFailed.exchange(true)) {
+                    ctx->p.setException(f.state->err);
+                }
+            }
+            else {
+                ctx->results[i] = std::move(*f.state->value);
+            }
+
+            if(ctx->remainNum.fetch_sub(1, std::memory_order_acq_rel) == 1 && !ctx->isFailed) {
+                if constexpr (std::is_void_v<T>) {
+                    ctx->p.setValue();
+                }
+                else {
+                    std::vector<T> vals;
+                    vals.reserve(ctx->results.size());
+                    for(auto& v : ctx->results) {
+                        vals.push_back(std::move(*v));
+                    }
+                    ctx->p.setValue(std::move(vals));
+                }
+            }
+        }, false);
+    }
+    return res;
+}
+
+// 以第一个完成的下标及其结果完成，void 时只有下标
+template<typename T>
+Future<std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, T>>> whenAny(std::vector<Future<T>> fs) {
+    using R = std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, T>>;
+    struct Context {
+        Promise<R> p;
+        std::atomic<bool> isDone;
+    };
+
+    auto ctx = std::make_shared<Context>();
+    Future<R> res = ctx->p.getFuture();
+    ctx->isDone = false;
+    for(size_t i=0;i<fs.size();++i) {
+        fs[i].onReady([ctx, i](Future<T>&& f) {
+            if(ctx->isDone.exchange(true)) {
+                return;
+            }
+            if(f.state->err) {
+                ctx->p.setException(f.state->err);
+            }
+            else if constexpr (std::is_void_v<T>) {
+                ctx->p.setValue(i);
+            }
+            else {
+                ctx->p.setValue(i, std::move(*f.state->value));
+            }
+        }, false);
+    }
+    return res;
+}
+
+template<typename F, typename... Args>
+requires std::invocable<std::decay_t<F>, std::decay_t<Args>...>
+Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> ThreadPool::submit(F&& f, Args&&... args) {
+    return this->submit(TaskOption(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<typename F, typename... Args>
+requires std::invocable<std::decay_t<F>, std::decay_t<Args>...>
+Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> ThreadPool::submit(const TaskOption& option, F&& f, Args&&... args) {
+    using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+    Promise<R> p;
+    Future<R> res = p.getFuture();
+    this->addTask(option, [p = std::move(p), f = std::forward<F>(f)](std::decay_t<Args>&&... a) mutable {
+        p.setWith([&]() -> R {
+            return std::invoke(std::move(f), std::move(a)...);
+        });
+    }, std::forward<Args>(args)...);
+    return res;
+}
+
+}
+
+#endif // _FUTURE_H_
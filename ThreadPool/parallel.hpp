@@ -0,0 +1,266 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <iterator>
+#include <optional>
+#include <algorithm>
+#include <future>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+#include "threadPool.hpp"
+
+/**
+ * @brief 基于线程池的并行算法
+ * @code {.cpp}
+ * std::vector<int> v(1000000);
+ * shochu::parallelFor(size_t(0), v.size(), [&](size_t i) { v[i] = i; });
+ * long s = shochu::parallelTransformReduce(v.begin(), v.end(), 0L, std::plus<>(), [](int x) { return (long)x; });
+ * shochu::parallelSort(v.begin(), v.end());
+ * shochu::parallelScan(v.begin(), v.end(), v.begin(), std::plus<>());
+ * @endcode
+ * @note 调用线程在等待时会执行线程池中的任务，因此也可以在任务内部调用
+ * @note grain 为每个任务至少处理的元素数，为0时按线程数自动选择
+ */
+namespace shochu {
+
+// 一组任务，wait 等待全部完成，等待期间执行线程池中的其他任务
+// 任务抛出的第一个异常在 wait 中重新抛出
+// 子任务带有投递线程的当前令牌，被取消或被丢弃时以 broken_promise 计入异常
+// 线程池已停止时子任务在 run 中直接执行
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool* pool = ThreadPool::getInstance()) : pool(pool), pendingNum(0) {}
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup() {
+        this->join();
+    }
+
+    template<typename F>
+    void run(F&& f) {
+        this->pendingNum.fetch_add(1, std::memory_order_relaxed);
+        Child<std::decay_t<F>> child(this, std::forward<F>(f));
+        if(!this->pool->addTask(std::move(child))) {
+            child();
+        }
+    }
+
+    void wait() {
+        this->join();
+        if(this->err) {
+            std::exception_ptr e = this->err;
+            this->err = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    // 子任务没有执行就被销毁（被取消、被 DiscardOldest 挤掉、Cancel 方式 shutdown）时
+    // 同样计入完成，否则 join 永远等不到
+    template<typename F>
+    class Child {
+    public:
+        template<typename FF>
+        Child(TaskGroup* g, FF&& f) : g(g), f(std::forward<FF>(f)) {}
+        Child(Child&& o) noexcept(std::is_nothrow_move_constructible_v<F>) : g(std::exchange(o.g, nullptr)), f(std::move(o.f)) {}
+        Child& operator=(Child&&) = delete;
+        ~Child() {
+            if(this->g) {
+                this->g->fail(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->g->done();
+            }
+        }
+
+        void operator()() {
+            TaskGroup* g = std::exchange(this->g, nullptr);
+            try {
+                this->f();
+            }
+            catch(...) {
+                g->fail(std::current_exception());
+            }
+            g->done();
+        }
+
+    private:
+        TaskGroup* g;
+        F f;
+    };
+
+    ThreadPool* pool;
+    std::atomic<size_t> pendingNum;
+    std::mutex m;
+    std::exception_ptr err;
+
+    void fail(std::exception_ptr e) {
+        std::lock_guard<std::mutex> l(this->m);
+        if(!this->err) {
+            this->err = e;
+        }
+    }
+
+    void done() {
+        // 在锁内减计数，保证 join 返回（TaskGroup 可能随即析构）时这里已经不再访问成员
+        ThreadPool* pool = this->pool;
+        bool isLast = false;
+        {
+            std::lock_guard<std::mutex> l(this->m);
+            isLast = this->pendingNum.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+        if(isLast) {
+            pool->notifyWaiter();
+        }
+    }
+
+    void join() {
+        this->pool->runUntil([this]() {
+            return this->pendingNum.load(std::memory_order_acquire) == 0;
+        });
+        std::lock_guard<std::mutex> l(this->m);
+    }
+};
+
+inline size_t parallelGrain(size_t n, size_t grain, ThreadPool* pool) {
+    if(grain) {
+        return grain;
+    }
+    size_t k = static_cast<size_t>(pool->getThreadNum() + 1) * 8;
+    return std::max<size_t>(1, n / k);
+}
+
+template<typename Index, typename F>
+void parallelForImpl(TaskGroup& g, Index first, Index last, size_t grain, F& f) {
+    // 递归二分，右半部分交给线程池，左半部分继续在本线程拆分
+    while(static_cast<size_t>(last - first) > grain) {
+        Index mid = first + (last - first) / 2;
+        g.run([&g, mid, last, grain, &f]() {
+            parallelForImpl(g, mid, last, grain, f);
+        });
+        last = mid;
+    }
+    for(Index i=first;i!=last;++i) {
+        f(i);
+    }
+}
+
+// 对 [first, last) 中的每个 i 调用 f(i)，Index 可以是整数或随机访问迭代器
+template<typename Index, typename F>
+void parallelFor(Index first, Index last, F&& f, size_t grain = 0, ThreadPool* pool = ThreadPool::getInstance()) {
+    if(!(first < last)) {
+        return;
+    }
+    grain = parallelGrain(static_cast<size_t>(last - first), grain, pool);
+    TaskGroup g(pool);
+    parallelForImpl(g, first, last, grain, f);
+    g.wait();
+}
+
+// 相当于 std::transform_reduce(first, last, init, reduce, transform)，reduce 需满足结合律
+template<typename It, typename T, typename Reduce, typename Transform>
+T parallelTransformReduce(It first, It last, T init, Reduce reduce, Transform transform,
+                          size_t grain = 0, ThreadPool* pool = ThreadPool::getInstance()) {
+    size_t n = std::distance(first, last);
+    if(n == 0) {
+        return init;
+    }
+    grain = parallelGrain(n, grain, pool);
+    size_t chunkNum = (n + grain - 1) / grain;
+
+    std::vector<std::optional<T>> partial(chunkNum);
+    parallelFor(size_t(0), chunkNum, [&](size_t c) {
+        It b = first + c * grain;
+        It e = first + std::min(n, (c + 1) * grain);
+        T acc = transform(*b);
+        for(++b;b!=e;++b) {
+            acc = reduce(std::move(acc), transform(*b));
+        }
+        partial[c] = std::move(acc);
+    }, 1, pool);
+
+    for(auto& p : partial) {
+        init = reduce(std::move(init), std::move(*p));
+    }
+    return init;
+}
+
+template<typename It, typename Compare>
+void parallelSortImpl(It first, It last, Compare& comp, size_t grain, ThreadPool* pool) {
+    size_t n = last - first;
+    if(n <= grain) {
+        std::sort(first, last, comp);
+        return;
+    }
+    It mid = first + n / 2;
+    TaskGroup g(pool);
+    g.run([first, mid, &comp, grain, pool]() {
+        parallelSortImpl(first, mid, comp, grain, pool);
+    });
+    parallelSortImpl(mid, last, comp, grain, pool);
+    g.wait();
+    std::inplace_merge(first, mid, last, comp);
+}
+
+// 并行归并排序，It 为随机访问迭代器
+template<typename It, typename Compare = std::less<>>
+void parallelSort(It first, It last, Compare comp = Compare(), size_t grain = 0, ThreadPool* pool = ThreadPool::getInstance()) {
+    size_t n = last - first;
+    // 太小的块排序开销比调度开销还小
+    grain = std::max<size_t>(parallelGrain(n, grain, pool), 1024);
+    parallelSortImpl(first, last, comp, grain, pool);
+}
+
+// 相当于 std::inclusive_scan(first, last, out, op)，op 需满足结合律，返回输出的尾后迭代器
+// out 为随机访问迭代器，可以与 first 相同
+template<typename It, typename OutIt, typename Op = std::plus<>>
+OutIt parallelScan(It first, It last, OutIt out, Op op = Op(), size_t grain = 0, ThreadPool* pool = ThreadPool::getInstance()) {
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t n = std::distance(first, last);
+    if(n == 0) {
+        return out;
+    }
+    grain = parallelGrain(n, grain, pool);
+    size_t chunkNum = (n + grain - 1) / grain;
+    if(chunkNum == 1) {
+        return std::inclusive_scan(first, last, out, op);
+    }
+
+    // 先求各块的和，再串行求各块的前缀，最后各块加上前缀后扫描
+    std::vector<std::optional<T>> sums(chunkNum);
+    parallelFor(size_t(0), chunkNum - 1, [&](size_t c) {
+        It b = first + c * grain;
+        It e = b + grain;
+        T acc = *b;
+        for(++b;b!=e;++b) {
+            acc = op(std::move(acc), *b);
+        }
+        sums[c] = std::move(acc);
+    }, 1, pool);
+    for(size_t c=1;c<chunkNum-1;++c) {
+        sums[c] = op(*sums[c - 1], std::move(*sums[c]));
+    }
+
+    parallelFor(size_t(0), chunkNum, [&](size_t c) {
+        It b = first + c * grain;
+        It e = first + std::min(n, (c + 1) * grain);
+        OutIt o = out + c * grain;
+        T acc = c ? op(*sums[c - 1], *b) : T(*b);
+        *o = acc;
+        for(++b, ++o;b!=e;++b, ++o) {
+            acc = op(std::move(acc), *b);
+            *o = acc;
+        }
+    }, 1, pool);
+    return out + n;
+}
+
+}
+
+#endif // _PARALLEL_H_
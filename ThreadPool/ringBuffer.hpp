@@ -0,0 +1,98 @@
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @brief 环形缓冲区实现的队列，接口与 std::queue 一致
+ * 容量总是2的幂，满时 emplace 会扩容，需要限制长度时由调用方先检查 size()
+ * @note 非线程安全
+ */
+namespace shochu {
+
+template<typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t cap = 16) : buf(nullptr), cap(0), head(0), tail(0) {
+        this->reserve(cap);
+    }
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+    ~RingBuffer() {
+        while(!this->empty()) {
+            this->pop();
+        }
+        this->alloc.deallocate(this->buf, this->cap);
+    }
+
+    size_t size() const {
+        return this->tail - this->head;
+    }
+    bool empty() const {
+        return this->tail == this->head;
+    }
+    size_t capacity() const {
+        return this->cap;
+    }
+
+    T& front() {
+        return this->buf[this->head & (this->cap - 1)];
+    }
+
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        if(this->size() == this->cap) {
+            this->reserve(this->cap * 2);
+        }
+        ::new(static_cast<void*>(this->buf + (this->tail & (this->cap - 1)))) T(std::forward<Args>(args)...);
+        ++this->tail;
+    }
+    void push(T&& v) {
+        this->emplace(std::move(v));
+    }
+
+    void pop() {
+        this->front().~T();
+        ++this->head;
+    }
+
+    // 容量扩大到不小于 n 的2的幂，已有元素保持顺序
+    void reserve(size_t n) {
+        size_t c = 1;
+        while(c < n) {
+            c <<= 1;
+        }
+        if(c <= this->cap) {
+            return;
+        }
+
+        T* b = this->alloc.allocate(c);
+        size_t n0 = this->size();
+        for(size_t i=0;i<n0;++i) {
+            T& v = this->buf[(this->head + i) & (this->cap - 1)];
+            ::new(static_cast<void*>(b + i)) T(std::move(v));
+            v.~T();
+        }
+        if(this->buf) {
+            this->alloc.deallocate(this->buf, this->cap);
+        }
+        this->buf = b;
+        this->cap = c;
+        this->head = 0;
+        this->tail = n0;
+    }
+
+private:
+    std::allocator<T> alloc;
+    T* buf;
+    size_t cap;
+    // 单调递增的读写位置，下标为与 cap-1 按位与的结果
+    size_t head;
+    size_t tail;
+};
+
+}
+
+#endif // _RING_BUFFER_H_
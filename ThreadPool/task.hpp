@@ -0,0 +1,157 @@
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include <new>
+#include <tuple>
+#include <cstddef>
+#include <utility>
+#include <concepts>
+#include <type_traits>
+
+/**
+ * @brief 只能移动的任务对象
+ * 可调用对象和绑定的参数较小时直接存放在对象内部，不再额外申请内存
+ * @code {.cpp}
+ * shochu::Task t([](int a, int b) { ... }, 1, 2);
+ * t();
+ * @endcode
+ */
+namespace shochu {
+
+class Task {
+public:
+    // 内部缓冲区大小，超过时退化为堆上分配
+    static constexpr size_t BufferSize = 48;
+
+    Task() noexcept : ops(nullptr) {}
+
+    template<typename F, typename... Args>
+    requires (!std::same_as<std::decay_t<F>, Task>
+              && std::invocable<std::decay_t<F>, std::decay_t<Args>...>)
+    explicit Task(F&& f, Args&&... args) : ops(nullptr) {
+        if constexpr (sizeof...(Args) == 0) {
+            this->emplace<std::decay_t<F>>(std::forward<F>(f));
+        }
+        else {
+            using Fn = BindFunc<std::decay_t<F>, std::decay_t<Args>...>;
+            this->emplace<Fn>(std::forward<F>(f), std::forward<Args>(args)...);
+        }
+    }
+
+    Task(Task&& o) noexcept : ops(o.ops) {
+        if(this->ops) {
+            this->ops->move(this->buf, o.buf);
+            o.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& o) noexcept {
+        if(this != &o) {
+            this->reset();
+            this->ops = o.ops;
+            if(this->ops) {
+                this->ops->move(this->buf, o.buf);
+                o.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        this->reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return this->ops != nullptr;
+    }
+
+    // 每个任务只执行一次，绑定的参数会被移动给可调用对象
+    void operator()() {
+        this->ops->run(this->buf);
+    }
+
+    void reset() noexcept {
+        if(this->ops) {
+            this->ops->destroy(this->buf);
+            this->ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*run)(void*);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<typename F, typename... Args>
+    struct BindFunc {
+        template<typename FF, typename... AA>
+        BindFunc(FF&& f, AA&&... a) : func(std::forward<FF>(f)), data(std::forward<AA>(a)...) {}
+
+        void operator()() {
+            std::apply(std::move(this->func), std::move(this->data));
+        }
+
+        F func;
+        std::tuple<Args...> data;
+    };
+
+    template<typename Fn>
+    static constexpr bool isInline = sizeof(Fn) <= BufferSize
+                                  && alignof(Fn) <= alignof(std::max_align_t)
+                                  && std::is_nothrow_move_constructible_v<Fn>;
+
+    // 存放在缓冲区内
+    template<typename Fn>
+    struct InlineOps {
+        static void run(void* p) {
+            (*static_cast<Fn*>(p))();
+        }
+        static void move(void* dst, void* src) noexcept {
+            ::new(dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void destroy(void* p) noexcept {
+            static_cast<Fn*>(p)->~Fn();
+        }
+        static constexpr Ops ops{run, move, destroy};
+    };
+
+    // 缓冲区内只存放指针
+    template<typename Fn>
+    struct HeapOps {
+        static void run(void* p) {
+            (**static_cast<Fn**>(p))();
+        }
+        static void move(void* dst, void* src) noexcept {
+            *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+        }
+        static void destroy(void* p) noexcept {
+            delete *static_cast<Fn**>(p);
+        }
+        static constexpr Ops ops{run, move, destroy};
+    };
+
+    template<typename Fn, typename... T>
+    void emplace(T&&... t) {
+        if constexpr (isInline<Fn>) {
+            ::new(static_cast<void*>(this->buf)) Fn(std::forward<T>(t)...);
+            this->ops = &InlineOps<Fn>::ops;
+        }
+        else {
+            *reinterpret_cast<Fn**>(this->buf) = new Fn(std::forward<T>(t)...);
+            this->ops = &HeapOps<Fn>::ops;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf[BufferSize];
+    const Ops* ops;
+};
+
+}
+
+#endif // _TASK_H_
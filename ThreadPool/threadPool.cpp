@@ -1,6 +1,80 @@
 #include "threadPool.hpp"
 
-#include <unistd.h>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#include <sched.h>
+#include <pthread.h>
+
+namespace {
+// 当前线程所属的线程池及其工作线程编号
+thread_local shochu::ThreadPool* currentPool = nullptr;
+thread_local unsigned int currentIndex = 0;
+
+// 解析 "0-3,8,10-11" 格式的核列表
+std::vector<int> parseCpuList(const std::string& s) {
+    std::vector<int> cpus;
+    size_t i = 0;
+    while(i < s.size()) {
+        size_t end = s.find(',', i);
+        if(end == std::string::npos) {
+            end = s.size();
+        }
+        std::string item = s.substr(i, end - i);
+        size_t dash = item.find('-');
+        try {
+            int beg = std::stoi(item);
+            int last = dash == std::string::npos ? beg : std::stoi(item.substr(dash + 1));
+            for(int c=beg;c<=last;++c) {
+                cpus.push_back(c);
+            }
+        }
+        catch(...) {
+        }
+        i = end + 1;
+    }
+    return cpus;
+}
+
+// 读取各 NUMA 节点的核，只保留当前进程可用的核
+// 读不到节点信息时所有核视为一个节点
+std::vector<std::vector<int>> loadNumaNodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<std::vector<int>> nodes;
+    for(int n=0;;++n) {
+        std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if(!f) {
+            break;
+        }
+        std::string line;
+        std::getline(f, line);
+        std::vector<int> cpus;
+        for(int c : parseCpuList(line)) {
+            if(c < CPU_SETSIZE && CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+            }
+        }
+        if(!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+
+    if(nodes.empty()) {
+        std::vector<int> cpus;
+        for(int c=0;c<CPU_SETSIZE;++c) {
+            if(CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+            }
+        }
+        nodes.push_back(std::move(cpus));
+    }
+    return nodes;
+}
+}
 
 shochu::ThreadPool* shochu::ThreadPool::getInstance() {
     static ThreadPool p;
@@ -8,68 +82,684 @@ shochu::ThreadPool* shochu::ThreadPool::getInstance() {
 }
 
 shochu::ThreadPool::ThreadPool() :
-    threadNum(4),
+    threadNum(0),
     taskMaxNum(10),
-    isQuit(false) {
-    using namespace std;
-    for(unsigned int i=0;i<this->threadNum;++i) {
-        this->threads.push_back(move(unique_ptr<thread>(new thread(&ThreadPool::workThread, this))));
-        this->threads[i]->detach();
-    }
-
-    std::thread(&ThreadPool::checkThread, this).detach();
+    qNum(0),
+    highNum(0),
+    agingTime(std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(100)).count()),
+    blockTimeout(-1),
+    blockedNum(0),
+    discardNum(0),
+    blockNum(0),
+    blockTimeoutNum(0),
+    discardOldestNum(0),
+    callerRunsNum(0),
+    isDropExpired(true),
+    expiredNum(0),
+    cancelledNum(0),
+    workers(MaxThreadNum),
+    slotNum(0),
+    affinityMode(NoAffinity),
+    isElastic(false),
+    minThreadNum(1),
+    maxThreadNum(MaxThreadNum),
+    maxLatency(0),
+    idleTimeout(0),
+    taskNum(0),
+    taskHighWater(0),
+    isTiming(false),
+    spinNum(64),
+    popBatchNum(16),
+    isQuit(false),
+    isCancel(false),
+    isStop(false),
+    idleNum(0),
+    timer([this](Task&& t) {
+        this->addTask(CancelToken::none(), std::move(t));
+    }) {
+    this->sharedMetrics.isShared = true;
+    unsigned int num = std::thread::hardware_concurrency();
+    this->lMutex.lock();
+    this->resize(num ? num : 4);
+    this->lMutex.unlock();
 }
 
 shochu::ThreadPool::~ThreadPool() {
+    this->shutdown(Drain);
+}
+
+void shochu::ThreadPool::shutdown(ShutdownMode mode) {
+    std::lock_guard<std::mutex> l(this->lMutex);
+    if(this->isQuit) {
+        return;
+    }
+    this->timer.stop();
+
+    this->cvMutex.lock();
+    this->isCancel = mode == Cancel;
     this->isQuit = true;
+    this->cvMutex.unlock();
     this->cv.notify_all();
-    //TODO: wait thread finish
-    
-}
+    this->qMutex.lock();
+    this->qMutex.unlock();
+    this->notFull.notify_all();
+
+    unsigned int n = this->slotNum;
+    for(unsigned int i=0;i<n;++i) {
+        if(this->workers[i]->th.joinable()) {
+            this->workers[i]->th.join();
+        }
+    }
+    this->threadNum = 0;
+
+    // 工作线程退出后才投递进来的任务，Drain 时在这里执行
+    bool hasTask = true;
+    while(hasTask) {
+        hasTask = false;
+        for(unsigned int i=0;i<n;++i) {
+            Worker& w = *this->workers[i];
+            std::deque<TaskItem> d;
+            w.dMutex.lock();
+            d.swap(w.d);
+            w.dMutex.unlock();
+            for(auto& item : d) {
+                hasTask = true;
+                --this->taskNum;
+                if(mode == Drain) {
+                    this->runTask(item, this->sharedMetrics);
+                }
+            }
+        }
 
-void shochu::ThreadPool::addTask(std::shared_ptr<TaskInterface> task, shochu::ThreadPool::AddTaskMethod method) {
-    // if(method != shochu::ThreadPool::Discard || this->q.size() < this->taskMaxNum) {
-    if(method != shochu::ThreadPool::Discard) {
         this->qMutex.lock();
-        this->q.push(task);
+        TaskItem item(Clock::time_point{}, TaskOption());
+        while(this->popShared(item)) {
+            this->qMutex.unlock();
+            hasTask = true;
+            --this->taskNum;
+            if(mode == Drain) {
+                this->runTask(item, this->sharedMetrics);
+            }
+            item.task.reset();
+            this->qMutex.lock();
+        }
+        this->isStop = !hasTask;
         this->qMutex.unlock();
     }
 }
 
-void shochu::ThreadPool::setTaskMaxNum(unsigned int num) {
-    this->taskMaxNum = num;
+void shochu::ThreadPool::resize(unsigned int num) {
+    num = std::clamp(num, 1u, MaxThreadNum);
+    unsigned int n = this->threadNum;
+    for(unsigned int i=n;i<num;++i) {
+        if(i >= this->slotNum) {
+            this->workers[i].reset(new Worker);
+            this->slotNum = i + 1;
+        }
+
+        Worker& w = *this->workers[i];
+        if(w.th.get_id() == std::this_thread::get_id()) {
+            // 在被要求退出的线程中又增加了线程，该线程还没有退出，直接保留
+            w.isRetire = false;
+            continue;
+        }
+        // 之前退出的线程需要先回收
+        if(w.th.joinable()) {
+            w.th.join();
+        }
+        w.isRetire = false;
+        w.th = std::thread(&ThreadPool::workThread, this, i);
+
+        std::string name = "shochu-pool-" + std::to_string(i);
+        pthread_setname_np(w.th.native_handle(), name.c_str());
+        if(this->affinityMode != NoAffinity) {
+            this->applyAffinity(i);
+        }
+    }
+    for(unsigned int i=num;i<n;++i) {
+        this->workers[i]->isRetire = true;
+    }
+    this->threadNum = num;
+
+    if(num < n) {
+        this->cvMutex.lock();
+        this->cvMutex.unlock();
+        this->cv.notify_all();
+    }
+}
+
+void shochu::ThreadPool::setAffinity(AffinityMode mode) {
+    std::lock_guard<std::mutex> l(this->lMutex);
+    this->affinityMode = mode;
+    if(this->numaNodes.empty()) {
+        this->numaNodes = loadNumaNodes();
+    }
+    unsigned int n = this->slotNum;
+    for(unsigned int i=0;i<n;++i) {
+        if(this->workers[i]->th.joinable()) {
+            this->applyAffinity(i);
+        }
+    }
+}
+
+void shochu::ThreadPool::applyAffinity(unsigned int index) {
+    std::vector<int> cpus;
+    int node = 0;
+    if(this->affinityMode == PinCore) {
+        size_t total = 0;
+        for(auto& cs : this->numaNodes) {
+            total += cs.size();
+        }
+        size_t k = index % total;
+        while(k >= this->numaNodes[node].size()) {
+            k -= this->numaNodes[node].size();
+            ++node;
+        }
+        cpus.push_back(this->numaNodes[node][k]);
+    }
+    else if(this->affinityMode == PinNode) {
+        node = index % this->numaNodes.size();
+        cpus = this->numaNodes[node];
+    }
+    else {
+        // 恢复为所有可用的核
+        for(auto& cs : this->numaNodes) {
+            cpus.insert(cpus.end(), cs.begin(), cs.end());
+        }
+    }
+
+    Worker& w = *this->workers[index];
+    w.node = node;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int c : cpus) {
+        CPU_SET(c, &set);
+    }
+    pthread_setaffinity_np(w.th.native_handle(), sizeof(set), &set);
 }
 
 void shochu::ThreadPool::setThreadNum(unsigned int num) {
-    this->threadNum = num;
+    std::lock_guard<std::mutex> l(this->lMutex);
+    if(!this->isQuit) {
+        this->resize(num);
+    }
 }
 
-void shochu::ThreadPool::workThread() {
-    while(!this->isQuit) {
-        this->cv.wait(this->cvMutex);
-        if(this->q.size()) {
-            this->qMutex.lock();
-            if(this->q.size()) {
-                auto task = this->q.front();
-                this->q.pop();
-                this->qMutex.unlock();
+unsigned int shochu::ThreadPool::getThreadNum() const {
+    return this->threadNum;
+}
+
+void shochu::ThreadPool::setElastic(const ElasticConfig& config) {
+    std::lock_guard<std::mutex> l(this->lMutex);
+    this->minThreadNum = std::clamp(config.minNum, 1u, MaxThreadNum);
+    this->maxThreadNum = std::clamp(config.maxNum, this->minThreadNum.load(), MaxThreadNum);
+    this->maxLatency = std::chrono::duration_cast<Clock::duration>(config.maxLatency).count();
+    this->idleTimeout = config.idleTimeout.count();
+    this->isElastic = true;
+    if(!this->isQuit) {
+        this->resize(std::clamp(this->threadNum.load(), this->minThreadNum.load(), this->maxThreadNum.load()));
+    }
+}
+
+void shochu::ThreadPool::disableElastic() {
+    this->isElastic = false;
+}
+
+void shochu::ThreadPool::growElastic() {
+    if(this->threadNum >= this->maxThreadNum || !this->lMutex.try_lock()) {
+        return;
+    }
+    if(!this->isQuit && this->threadNum < this->maxThreadNum) {
+        this->resize(this->threadNum + 1);
+    }
+    this->lMutex.unlock();
+}
+
+bool shochu::ThreadPool::retireIdle(unsigned int index) {
+    if(!this->lMutex.try_lock()) {
+        return false;
+    }
+    // 只让编号最大的线程退出，保持编号连续
+    bool ok = !this->isQuit && index + 1 == this->threadNum && this->threadNum > this->minThreadNum;
+    if(ok) {
+        this->workers[index]->isRetire = true;
+        --this->threadNum;
+    }
+    this->lMutex.unlock();
+    return ok;
+}
+
+bool shochu::ThreadPool::addTask(std::shared_ptr<TaskInterface> task, const TaskOption& option) {
+    return this->emplaceTask(option, [task = std::move(task)]() {
+        task->run();
+    });
+}
+
+bool shochu::ThreadPool::makeRoom(AddTaskMethod method, std::unique_lock<std::mutex>& lock, std::vector<Task>& dropped) {
+    switch(method) {
+    case Discard:
+        ++this->discardNum;
+        return false;
+    case DiscardOldest:
+        // 优先丢弃低优先级的任务
+        for(int p=Low;p>=High;--p) {
+            if(!this->q[p].empty()) {
+                dropped.push_back(std::move(this->q[p].front().task));
+                this->q[p].pop();
+                --this->qNum;
+                if(p == High) {
+                    --this->highNum;
+                }
+                --this->taskNum;
+                ++this->discardOldestNum;
+                return true;
+            }
+        }
+        // 队列为空（taskMaxNum 为0）时没有可丢弃的任务，按 Discard 处理
+        ++this->discardNum;
+        return false;
+    case CallerRuns:
+        ++this->callerRunsNum;
+        return false;
+    case Block: {
+        ++this->blockNum;
+        ++this->blockedNum;
+        auto hasRoom = [this]() {
+            return this->qNum < this->taskMaxNum || this->isQuit;
+        };
+        bool ok = true;
+        if(this->blockTimeout.count() < 0) {
+            this->notFull.wait(lock, hasRoom);
+        }
+        else {
+            ok = this->notFull.wait_for(lock, this->blockTimeout, hasRoom);
+        }
+        --this->blockedNum;
+        if(!ok) {
+            ++this->blockTimeoutNum;
+        }
+        return ok;
+    }
+    default:
+        return true;
+    }
+}
+
+shochu::ThreadPool::Worker* shochu::ThreadPool::localWorker() {
+    return currentPool == this ? this->workers[currentIndex].get() : nullptr;
+}
+
+void shochu::ThreadPool::notifyWorker(size_t n) {
+    // taskNum 先于 idleNum 读取，与 workThread 中的顺序相反，保证不会丢失唤醒
+    size_t idle = this->idleNum;
+    if(idle && n) {
+        // 加锁保证等待方要么还未检查条件，要么已经进入休眠
+        this->cvMutex.lock();
+        this->cvMutex.unlock();
+        if(n >= idle) {
+            this->cv.notify_all();
+        }
+        else {
+            while(n--) {
+                this->cv.notify_one();
+            }
+        }
+    }
+}
+
+void shochu::ThreadPool::notifyWaiter() {
+    this->cvMutex.lock();
+    this->cvMutex.unlock();
+    this->cv.notify_all();
+}
+
+void shochu::ThreadPool::setTaskMaxNum(unsigned int num) {
+    // 只为较小的上限预先分配，更大的由队列按需扩容，避免一次申请过多内存
+    constexpr unsigned int MaxReserveNum = 1024;
+    {
+        std::lock_guard<std::mutex> l(this->qMutex);
+        this->taskMaxNum = num;
+        this->q[Normal].reserve(std::min(num, MaxReserveNum));
+    }
+    this->notFull.notify_all();
+}
+
+void shochu::ThreadPool::setBlockTimeout(std::chrono::milliseconds timeout) {
+    this->qMutex.lock();
+    this->blockTimeout = timeout;
+    this->qMutex.unlock();
+}
+
+size_t shochu::ThreadPool::Histogram::count() const {
+    size_t n = 0;
+    for(int i=0;i<BucketNum;++i) {
+        n += this->bucket[i];
+    }
+    return n;
+}
+
+uint64_t shochu::ThreadPool::Histogram::percentile(double p) const {
+    size_t n = this->count();
+    if(n == 0) {
+        return 0;
+    }
+    size_t target = std::max<size_t>(1, static_cast<size_t>(p * n + 0.5));
+    size_t sum = 0;
+    for(int i=0;i<BucketNum;++i) {
+        sum += this->bucket[i];
+        if(sum >= target) {
+            return i ? (uint64_t(1) << i) - 1 : 0;
+        }
+    }
+    return (uint64_t(1) << (BucketNum - 1)) - 1;
+}
+
+void shochu::ThreadPool::setTiming(bool isTiming) {
+    this->isTiming = isTiming;
+}
+
+shochu::ThreadPool::Stat shochu::ThreadPool::snapshot() const {
+    Stat stat{};
+    auto collect = [&stat](const Metrics& m, bool isRunning) {
+        WorkerStat ws;
+        ws.isRunning = isRunning;
+        ws.executedNum = m.executedNum.load(std::memory_order_relaxed);
+        ws.stolenNum = m.stolenNum.load(std::memory_order_relaxed);
+        ws.busyNs = m.busyNs.load(std::memory_order_relaxed);
+        ws.idleNs = m.idleNs.load(std::memory_order_relaxed);
+        stat.executedNum += ws.executedNum;
+        stat.stolenNum += ws.stolenNum;
+        for(int i=0;i<Histogram::BucketNum;++i) {
+            stat.waitTime.bucket[i] += m.waitTime[i].load(std::memory_order_relaxed);
+            stat.runTime.bucket[i] += m.runTime[i].load(std::memory_order_relaxed);
+        }
+        stat.workers.push_back(ws);
+    };
+
+    unsigned int n = this->slotNum;
+    unsigned int active = this->threadNum;
+    for(unsigned int i=0;i<n;++i) {
+        collect(this->workers[i]->metrics, i < active);
+    }
+    collect(this->sharedMetrics, false);
+
+    stat.expiredNum = this->expiredNum;
+    stat.cancelledNum = this->cancelledNum;
+    stat.taskNum = this->taskNum;
+    stat.taskHighWater = this->taskHighWater;
+    stat.overflow = this->getOverflowStat();
+    return stat;
+}
+
+void shochu::ThreadPool::setAgingTime(std::chrono::milliseconds time) {
+    this->agingTime = std::chrono::duration_cast<Clock::duration>(time).count();
+}
+
+void shochu::ThreadPool::setDropExpired(bool isDrop) {
+    this->isDropExpired = isDrop;
+}
+
+size_t shochu::ThreadPool::getExpiredNum() const {
+    return this->expiredNum;
+}
+
+size_t shochu::ThreadPool::getCancelledNum() const {
+    return this->cancelledNum;
+}
+
+shochu::ThreadPool::OverflowStat shochu::ThreadPool::getOverflowStat() const {
+    OverflowStat stat;
+    stat.discardNum = this->discardNum;
+    stat.blockNum = this->blockNum;
+    stat.blockTimeoutNum = this->blockTimeoutNum;
+    stat.discardOldestNum = this->discardOldestNum;
+    stat.callerRunsNum = this->callerRunsNum;
+    return stat;
+}
+
+void shochu::ThreadPool::setPopBatchNum(unsigned int num) {
+    this->popBatchNum = num;
+}
+
+void shochu::ThreadPool::setSpinNum(unsigned int num) {
+    this->spinNum = num;
+}
+
+bool shochu::ThreadPool::popTask(unsigned int index, TaskItem& item) {
+    if(this->highNum) {
+        this->qMutex.lock();
+        bool ok = this->popShared(item);
+        this->qMutex.unlock();
+        if(ok) {
+            --this->taskNum;
+            if(this->blockedNum) {
+                this->notFull.notify_one();
+            }
+            return true;
+        }
+    }
+
+    Worker& w = *this->workers[index];
+    w.dMutex.lock();
+    if(!w.d.empty()) {
+        item = std::move(w.d.back());
+        w.d.pop_back();
+        w.dMutex.unlock();
+        --this->taskNum;
+        return true;
+    }
+    w.dMutex.unlock();
+
+    this->qMutex.lock();
+    if(this->popShared(item)) {
+        // 本线程队列已空，按线程数均分公共队列中剩余的 Normal 任务，一次取走一批
+        RingBuffer<TaskItem>& nq = this->q[Normal];
+        size_t batch = std::min<size_t>(this->popBatchNum, nq.size() / (this->threadNum + 1));
+        if(batch && !this->highNum) {
+            w.dMutex.lock();
+            for(size_t i=0;i<batch;++i) {
+                // 先取出的放在尾部，本线程按原顺序执行
+                w.d.push_front(std::move(nq.front()));
+                nq.pop();
+            }
+            w.dMutex.unlock();
+            this->qNum -= batch;
+        }
+        this->qMutex.unlock();
+        --this->taskNum;
+        if(this->blockedNum) {
+            this->notFull.notify_all();
+        }
+        return true;
+    }
+    this->qMutex.unlock();
+
+    return this->stealTask(index, item);
+}
+
+bool shochu::ThreadPool::popShared(TaskItem& item) {
+    if(!this->qNum) {
+        return false;
+    }
+
+    // 等待过久的低优先级任务先执行，避免饿死
+    int lane = PriorityNum;
+    Clock::time_point now = Clock::now();
+    for(int p=Low;p>High;--p) {
+        if(!this->q[p].empty() && (now - this->q[p].front().submitTime).count() > this->agingTime) {
+            lane = p;
+            break;
+        }
+    }
+    for(int p=High;p<PriorityNum && lane==PriorityNum;++p) {
+        if(!this->q[p].empty()) {
+            lane = p;
+        }
+    }
 
-                task->run();
+    item = std::move(this->q[lane].front());
+    this->q[lane].pop();
+    --this->qNum;
+    if(lane == High) {
+        --this->highNum;
+    }
+    return true;
+}
+
+bool shochu::ThreadPool::stealTask(unsigned int index, TaskItem& item) {
+    // 已退出线程的队列也要检查
+    unsigned int n = this->slotNum;
+    bool isWorker = index < n;
+    int node = isWorker ? this->workers[index]->node.load() : 0;
+    // 先窃取同一 NUMA 节点的线程，再窃取其他节点的
+    for(int pass=0;pass<2;++pass) {
+        for(unsigned int i=isWorker?1:0;i<n;++i) {
+            Worker& w = *this->workers[(index + i) % n];
+            if((w.node == node) != (pass == 0)) {
+                continue;
             }
-            else {
-                this->qMutex.unlock();
+            // 对方正忙于存取时直接跳过，避免在窃取上排队
+            if(!w.dMutex.try_lock()) {
+                continue;
+            }
+            if(!w.d.empty()) {
+                item = std::move(w.d.front());
+                w.d.pop_front();
+                w.dMutex.unlock();
+                --this->taskNum;
+                Metrics& m = isWorker ? this->workers[index]->metrics : this->sharedMetrics;
+                m.add(m.stolenNum);
+                return true;
+            }
+            w.dMutex.unlock();
+        }
+    }
+    return false;
+}
+
+bool shochu::ThreadPool::tryRunTask() {
+    TaskItem item(Clock::time_point{}, TaskOption());
+    if(Worker* w = this->localWorker()) {
+        if(!this->popTask(currentIndex, item)) {
+            return false;
+        }
+        this->runTask(item, w->metrics);
+        return true;
+    }
+    else {
+        this->qMutex.lock();
+        bool ok = this->popShared(item);
+        this->qMutex.unlock();
+        if(ok) {
+            --this->taskNum;
+            if(this->blockedNum) {
+                this->notFull.notify_one();
             }
         }
+        else if(!this->stealTask(MaxThreadNum, item)) {
+            return false;
+        }
     }
+    this->runTask(item, this->sharedMetrics);
+    return true;
 }
 
-void shochu::ThreadPool::checkThread() {
-    struct timespec t = {.tv_sec=0, .tv_nsec= 50 * 1000};
-    while(!this->isQuit) {
-        if(this->q.size()) {
-            this->cv.notify_one();
+void shochu::ThreadPool::runTask(TaskItem& item, Metrics& metrics) {
+    if(item.token.isCancelled()) {
+        ++this->cancelledNum;
+        item.task.reset();
+        item.token = CancelToken();
+        return;
+    }
+
+    bool isTiming = this->isTiming;
+    Clock::time_point now;
+    if(item.deadline != Clock::time_point() || this->isElastic || isTiming) {
+        now = Clock::now();
+        if(this->isElastic && item.submitTime != Clock::time_point()
+           && (now - item.submitTime).count() > this->maxLatency) {
+            this->growElastic();
         }
+        if(item.deadline != Clock::time_point() && now > item.deadline && this->isDropExpired) {
+            ++this->expiredNum;
+            item.task.reset();
+            return;
+        }
+        if(isTiming && item.submitTime != Clock::time_point()) {
+            metrics.addTime(metrics.waitTime, std::chrono::duration_cast<std::chrono::nanoseconds>(now - item.submitTime).count());
+        }
+    }
+
+    {
+        // 任务内部投递的任务继承该任务的令牌
+        CancelScope scope(std::move(item.token));
+        item.task();
+        item.task.reset();
+    }
+
+    metrics.add(metrics.executedNum);
+    if(isTiming) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - now).count();
+        metrics.add(metrics.busyNs, ns);
+        metrics.addTime(metrics.runTime, ns);
+    }
+}
+
+void shochu::ThreadPool::workThread(unsigned int index) {
+    currentPool = this;
+    currentIndex = index;
+    Worker& self = *this->workers[index];
 
-        nanosleep(&t, nullptr);
+    // 自适应自旋次数：自旋等到了任务就加倍，否则减半
+    unsigned int spin = this->spinNum;
+    TaskItem item(Clock::time_point{}, TaskOption());
+    while(!self.isRetire && !this->isCancel) {
+        if(this->popTask(index, item)) {
+            this->runTask(item, self.metrics);
+            continue;
+        }
+        if(this->isQuit) {
+            // Drain 时没有任务可取就退出
+            break;
+        }
+
+        bool found = false;
+        for(unsigned int i=0;i<spin && !this->isQuit;++i) {
+            if(this->taskNum && this->popTask(index, item)) {
+                found = true;
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if(found) {
+            spin = std::min(spin * 2 + 1, this->spinNum.load());
+            this->runTask(item, self.metrics);
+            continue;
+        }
+        spin /= 2;
+
+        std::unique_lock<std::mutex> lock(this->cvMutex);
+        auto ready = [this, &self]() {
+            return this->isQuit || self.isRetire || this->taskNum;
+        };
+        ++this->idleNum;
+        bool isTiming = this->isTiming;
+        Clock::time_point idleBeg = isTiming ? Clock::now() : Clock::time_point();
+        bool isTimeout = false;
+        if(this->isElastic) {
+            isTimeout = !this->cv.wait_for(lock, std::chrono::milliseconds(this->idleTimeout), ready);
+        }
+        else {
+            this->cv.wait(lock, ready);
+        }
+        --this->idleNum;
+        lock.unlock();
+        if(isTiming) {
+            self.metrics.add(self.metrics.idleNs, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - idleBeg).count());
+        }
+
+        if(isTimeout && this->retireIdle(index)) {
+            break;
+        }
     }
 }
@@ -1,23 +1,66 @@
-#include <queue>
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <bit>
+#include <deque>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <tuple>
 #include <vector>
 #include <thread>
 #include <memory>
 #include <functional>
+#include <ranges>
+#include <iterator>
 #include <condition_variable>
 
+#include "task.hpp"
+#include "ringBuffer.hpp"
+#include "cancel.hpp"
+#include "timerWheel.hpp"
+
 /**
  * @brief 线程池
  * @code {.cpp}
  * shared_ptr<shochu::ThreadPoolTask<Args...>> task(new shochu::ThreadPoolTask<Args...>(func));
  * task->data = makr_tuple(...);
  * ThreadPool::getInstance()->addTask(task);
+ *
+ * // 直接投递可调用对象和参数，任务在队列中原地构造
+ * ThreadPool::getInstance()->addTask(func, args...);
+ *
+ * // 一次投递一批任务，只加一次锁
+ * std::vector<Task> tasks;
+ * ThreadPool::getInstance()->addTasks(tasks);
  * @endcode
  * @note 用make_shared会报错
+ * @note 每个工作线程有自己的任务队列，空闲时从其他线程窃取任务；
+ *       在任务内部投递的任务直接进入当前线程的队列
+ * @note 没有任务时工作线程先自旋一小段时间再休眠，投递任务时直接唤醒休眠的线程
+ * @note 公共队列长度达到 taskMaxNum 后按 AddTaskMethod 处理新任务，
+ *       任务内部投递的任务进入本线程队列，不受此限制
+ * @note 默认的 Push 方式不检查 taskMaxNum，队列没有上限，投递快于执行时内存会一直增长；
+ *       需要有界队列时必须在投递时显式指定 Discard/Block/DiscardOldest/CallerRuns
+ * @note 线程数默认为 hardware_concurrency()，可以用 setThreadNum 随时调整，
+ *       或用 setElastic 按排队时间自动增减
+ * @note 公共队列按优先级分为多条，高优先级先执行，等待超过 agingTime 的任务提到最前；
+ *       设置了截止时间的任务过期后可以不再执行，见 TaskOption
+ * @note 工作线程名为 shochu-pool-<编号>，可以用 setAffinity 绑定到核或 NUMA 节点，
+ *       窃取任务时优先选择同一节点的线程
+ * @note snapshot() 返回运行统计，计数总是开启，
+ *       排队/执行耗时需要 setTiming(true)，每个任务多两次取时间的开销
+ * @note scheduleAfter/scheduleEvery 由时间轮在到期时投递任务，精度 1ms
+ * @note TaskOption::token 被取消后尚未开始的任务不再执行，见 cancel.hpp
+ * @note 协程中 co_await pool->schedule() 后在工作线程中继续执行，见 coroutine.hpp
  */
 namespace shochu {
 
+template<typename T>
+class Future;
+class ScheduleAwaiter;
+
 class TaskInterface {
 public:
     virtual void run() = 0;
@@ -49,33 +92,488 @@ public:
     static ThreadPool* getInstance();
 
     ~ThreadPool();
+    // 公共队列已满时的处理方式
     enum AddTaskMethod {
-        Push,
-        Discard
+        Push,           // 默认方式，不限长度，照常入队，taskMaxNum 对其不起作用
+        Discard,        // 丢弃新任务
+        Block,          // 阻塞等待空位，超时后丢弃新任务，见 setBlockTimeout
+        DiscardOldest,  // 丢弃队列中最早的任务，队列为空时同 Discard
+        CallerRuns      // 在调用 addTask 的线程中直接执行
+    };
+    enum Priority {
+        High,
+        Normal,
+        Low,
+        PriorityNum
+    };
+
+    // 投递任务的选项，可以由 AddTaskMethod 或 Priority 隐式构造
+    // 非 Normal 优先级的任务总是进入公共队列
+    struct TaskOption {
+        TaskOption(AddTaskMethod m = Push, Priority p = Normal) : method(m), priority(p) {}
+        TaskOption(Priority p) : method(Push), priority(p) {}
+        TaskOption(CancelToken t) : method(Push), priority(Normal), token(std::move(t)) {}
+
+        AddTaskMethod method;
+        Priority priority;
+        // 默认不设截止时间
+        std::chrono::steady_clock::time_point deadline;
+        // 默认使用投递线程的当前令牌，见 CancelToken::current，
+        // CancelToken::none() 表示不带令牌
+        CancelToken token;
+    };
+
+    // 各种处理方式被触发的次数
+    struct OverflowStat {
+        size_t discardNum;
+        size_t blockNum;
+        size_t blockTimeoutNum;
+        size_t discardOldestNum;
+        size_t callerRunsNum;
+    };
+
+    // 任务被丢弃（线程池已停止、Discard、Block 超时）时返回 false，此时 f 和 args 没有被移走；
+    // CallerRuns 时任务已经在本线程执行，返回 true
+    bool addTask(std::shared_ptr<TaskInterface> task, const TaskOption& option = TaskOption());
+
+    template<typename F, typename... Args>
+    requires std::constructible_from<Task, F, Args...>
+    bool addTask(F&& f, Args&&... args) {
+        return this->emplaceTask(TaskOption(), std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<typename F, typename... Args>
+    requires std::constructible_from<Task, F, Args...>
+    bool addTask(const TaskOption& option, F&& f, Args&&... args) {
+        return this->emplaceTask(option, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // 一次投递一批任务，元素会被移走，整批只加一次锁并按任务数唤醒线程
+    // 公共队列已满时对超出的任务逐个按 option.method 处理
+    template<typename It>
+    requires std::constructible_from<Task, std::iter_rvalue_reference_t<It>>
+    void addTasks(It first, It last, const TaskOption& option = TaskOption());
+
+    template<std::ranges::range R>
+    requires std::constructible_from<Task, std::ranges::range_rvalue_reference_t<R>>
+    void addTasks(R&& r, const TaskOption& option = TaskOption()) {
+        this->addTasks(std::ranges::begin(r), std::ranges::end(r), option);
+    }
+
+    // 在当前线程中取出并执行一个等待中的任务，没有任务时返回 false
+    // 用于等待其他任务完成时参与执行，见 parallel.hpp
+    bool tryRunTask();
+
+    // 在当前线程中执行等待中的任务直到 isDone() 为 true，没有任务可执行时休眠，
+    // 投递了新任务或调用 notifyWaiter 时醒来
+    template<typename P>
+    void runUntil(P&& isDone);
+    // isDone 的结果改变后调用，唤醒在 runUntil 中休眠的线程
+    void notifyWaiter();
+
+    // 同 addTask，返回的 Future 可以获取 f 的返回值或抛出的异常，见 future.hpp
+    // 任务被丢弃时 Future 以 broken_promise 完成
+    template<typename F, typename... Args>
+    requires std::invocable<std::decay_t<F>, std::decay_t<Args>...>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(F&& f, Args&&... args);
+
+    template<typename F, typename... Args>
+    requires std::invocable<std::decay_t<F>, std::decay_t<Args>...>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(const TaskOption& option, F&& f, Args&&... args);
+
+    // delay 后投递 f，返回的句柄可以在到期前取消，见 timerWheel.hpp
+    // 线程池已停止时返回无效的句柄，f 不会被移走
+    template<typename F>
+    requires std::constructible_from<Task, F>
+    TimerHandle scheduleAfter(std::chrono::steady_clock::duration delay, F&& f) {
+        return this->timer.after(delay, std::forward<F>(f));
+    }
+
+    // 每隔 period 投递一次 f，直到句柄被取消或线程池停止
+    template<typename F>
+    requires std::invocable<std::decay_t<F>&>
+    TimerHandle scheduleEvery(std::chrono::steady_clock::duration period, F&& f) {
+        return this->timer.every(period, std::forward<F>(f));
+    }
+
+    // 协程 co_await 返回值后挂起，并作为任务在线程池中恢复，见 coroutine.hpp
+    ScheduleAwaiter schedule();
+
+    // 最多同时存在的工作线程数
+    static constexpr unsigned int MaxThreadNum = 256;
+
+    enum ShutdownMode {
+        Drain,  // 执行完已投递的任务后退出
+        Cancel  // 执行完正在执行的任务后退出，丢弃其余任务
     };
-    void addTask(std::shared_ptr<TaskInterface> task, AddTaskMethod method = Push);
+    // 停止并等待所有工作线程退出，之后投递的任务会被丢弃
+    // 未到期的定时器不再触发
+    // 不能在任务内部调用
+    void shutdown(ShutdownMode mode = Drain);
 
+    // 弹性线程数：任务在公共队列中等待超过 maxLatency 时增加线程，
+    // 线程空闲超过 idleTimeout 时退出，线程数保持在 [minNum, maxNum]
+    struct ElasticConfig {
+        unsigned int minNum;
+        unsigned int maxNum;
+        std::chrono::microseconds maxLatency;
+        std::chrono::milliseconds idleTimeout;
+    };
+    void setElastic(const ElasticConfig& config);
+    void disableElastic();
+
+    // 运行时增减工作线程，减少时多出的线程执行完当前任务后退出
     void setThreadNum(unsigned int num);
+    unsigned int getThreadNum() const;
     void setTaskMaxNum(unsigned int num);
+    // Block 方式的最长等待时间，小于0表示一直等待
+    void setBlockTimeout(std::chrono::milliseconds timeout);
+    OverflowStat getOverflowStat() const;
+    // 低优先级任务等待超过该时间后优先执行
+    void setAgingTime(std::chrono::milliseconds time);
+    // 是否丢弃已过截止时间的任务，默认丢弃
+    void setDropExpired(bool isDrop);
+    // 因过期被丢弃的任务数
+    size_t getExpiredNum() const;
+    // 因令牌被取消而没有执行的任务数
+    size_t getCancelledNum() const;
+    enum AffinityMode {
+        NoAffinity, // 不绑定，由系统调度
+        PinCore,    // 每个线程绑定一个核，占满一个 NUMA 节点后再用下一个节点
+        PinNode     // 每个线程绑定一个 NUMA 节点的所有核，线程轮流分配到各节点
+    };
+    // 对已有和之后创建的工作线程生效
+    void setAffinity(AffinityMode mode);
+
+    // 耗时分布，bucket[i] 为耗时在 [2^(i-1), 2^i) 纳秒内的次数，bucket[0] 为耗时0的次数
+    struct Histogram {
+        static constexpr int BucketNum = 48;
+        size_t bucket[BucketNum];
+
+        size_t count() const;
+        // p 分位数所在区间的上界（纳秒），p 取 0~1
+        uint64_t percentile(double p) const;
+    };
+    struct WorkerStat {
+        bool isRunning;
+        size_t executedNum;
+        // 从其他线程队列窃取的任务数
+        size_t stolenNum;
+        uint64_t busyNs;
+        uint64_t idleNs;
+    };
+    struct Stat {
+        // 下标为工作线程编号，最后一项为非工作线程通过 tryRunTask 执行的统计
+        std::vector<WorkerStat> workers;
+        size_t executedNum;
+        size_t stolenNum;
+        size_t expiredNum;
+        size_t cancelledNum;
+        // 当前等待执行的任务数及其历史最大值
+        size_t taskNum;
+        size_t taskHighWater;
+        OverflowStat overflow;
+        // 从投递到开始执行、执行本身的耗时
+        Histogram waitTime;
+        Histogram runTime;
+    };
+    // 不停止工作线程，各计数分别读取，彼此之间不保证是同一时刻的值
+    Stat snapshot() const;
+    // 是否统计耗时，默认关闭
+    void setTiming(bool isTiming);
+
+    // 工作线程从公共队列取任务时最多额外取走的任务数，放入本线程队列
+    void setPopBatchNum(unsigned int num);
+
+    // 工作线程休眠前自旋等待新任务的最大次数，0 表示不自旋
+    void setSpinNum(unsigned int num);
 
 private:
-    unsigned int threadNum;
+    using Clock = std::chrono::steady_clock;
+
+    struct TaskItem {
+        template<typename... T>
+        TaskItem(Clock::time_point t, const TaskOption& option, T&&... a) :
+            task(std::forward<T>(a)...),
+            submitTime(t),
+            deadline(option.deadline),
+            token(option.token.valid() || option.token.isNone() ? option.token : CancelToken::current()) {}
+
+        Task task;
+        // 公共队列中的任务总是记录，本线程队列中的任务只在需要统计排队时间时记录
+        Clock::time_point submitTime;
+        Clock::time_point deadline;
+        CancelToken token;
+    };
+
+    // 每个工作线程独占一个缓存行，只由该线程写入
+    struct alignas(64) Metrics {
+        std::atomic<uint64_t> executedNum{0};
+        std::atomic<uint64_t> stolenNum{0};
+        std::atomic<uint64_t> busyNs{0};
+        std::atomic<uint64_t> idleNs{0};
+        std::atomic<uint64_t> waitTime[Histogram::BucketNum]{};
+        std::atomic<uint64_t> runTime[Histogram::BucketNum]{};
+        // 多个线程共用时为 true
+        bool isShared = false;
+
+        void add(std::atomic<uint64_t>& c, uint64_t v = 1) {
+            if(this->isShared) {
+                c.fetch_add(v, std::memory_order_relaxed);
+            }
+            else {
+                c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+            }
+        }
+        void addTime(std::atomic<uint64_t>* hist, uint64_t ns) {
+            int i = std::min<int>(std::bit_width(ns), Histogram::BucketNum - 1);
+            this->add(hist[i]);
+        }
+    };
+
+    // 每个工作线程私有的任务队列
+    // 本线程从尾部存取，其他线程从头部窃取
+    struct Worker {
+        Metrics metrics;
+
+        std::mutex dMutex;
+        std::deque<TaskItem> d;
+
+        std::thread th;
+        // 被要求退出，退出后队列中剩余的任务仍可被窃取
+        std::atomic<bool> isRetire{false};
+        // 所在的 NUMA 节点，未绑定时为0
+        std::atomic<int> node{0};
+    };
+
+    // 工作线程编号为 [0, threadNum)
+    std::atomic<unsigned int> threadNum;
     unsigned int taskMaxNum;
 
+    // 非工作线程投递的任务，及非 Normal 优先级的任务，按优先级分开
     std::mutex qMutex;
-    std::queue<std::shared_ptr<TaskInterface>> q;
+    RingBuffer<TaskItem> q[PriorityNum];
+    // 公共队列中的任务总数
+    size_t qNum;
+    std::atomic<size_t> highNum;
+    std::atomic<Clock::duration::rep> agingTime;
+    // 等待公共队列出现空位
+    std::condition_variable notFull;
+    std::chrono::milliseconds blockTimeout;
+    std::atomic<unsigned int> blockedNum;
+
+    std::atomic<size_t> discardNum;
+    std::atomic<size_t> blockNum;
+    std::atomic<size_t> blockTimeoutNum;
+    std::atomic<size_t> discardOldestNum;
+    std::atomic<size_t> callerRunsNum;
+
+    std::atomic<bool> isDropExpired;
+    std::atomic<size_t> expiredNum;
+    std::atomic<size_t> cancelledNum;
+
+    // 长度固定为 MaxThreadNum，前 slotNum 个已创建
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned int> slotNum;
+    // 线程增减、关闭和绑核
+    std::mutex lMutex;
+    AffinityMode affinityMode;
+    // 各 NUMA 节点的核编号，第一次 setAffinity 时读取
+    std::vector<std::vector<int>> numaNodes;
 
-    bool isQuit;
+    std::atomic<bool> isElastic;
+    std::atomic<unsigned int> minThreadNum;
+    std::atomic<unsigned int> maxThreadNum;
+    std::atomic<Clock::duration::rep> maxLatency;
+    std::atomic<std::chrono::milliseconds::rep> idleTimeout;
+
+    // 尚未被取走的任务总数
+    std::atomic<size_t> taskNum;
+    std::atomic<size_t> taskHighWater;
+    std::atomic<bool> isTiming;
+    // 非工作线程执行任务的统计
+    Metrics sharedMetrics;
+
+    std::atomic<unsigned int> spinNum;
+    std::atomic<unsigned int> popBatchNum;
+
+    // isQuit 后工作线程开始退出，isCancel 时不再执行剩余任务
+    // isStop 后 shutdown 已经完成，不再接受任务
+    std::atomic<bool> isQuit;
+    std::atomic<bool> isCancel;
+    std::atomic<bool> isStop;
     std::mutex cvMutex;
-    std::condition_variable_any cv;
+    std::condition_variable cv;
+    // 正在 cv 上休眠的工作线程数
+    std::atomic<unsigned int> idleNum;
 
-    std::vector<std::unique_ptr<std::thread>> threads;
+    TimerWheel timer;
 
 private:
     ThreadPool();
-    void workThread();
-    void checkThread();
+    void workThread(unsigned int index);
+    // 持有 lMutex 时调用
+    void resize(unsigned int num);
+    void applyAffinity(unsigned int index);
+    // 排队时间过长时增加一个线程
+    void growElastic();
+    // 空闲超时的线程尝试退出，成功时返回 true
+    bool retireIdle(unsigned int index);
+    // 执行统计记入 metrics
+    void runTask(TaskItem& item, Metrics& metrics);
+    void addTaskNum(size_t n) {
+        size_t num = this->taskNum.fetch_add(n) + n;
+        size_t hw = this->taskHighWater.load(std::memory_order_relaxed);
+        while(num > hw && !this->taskHighWater.compare_exchange_weak(hw, num, std::memory_order_relaxed)) {
+        }
+    }
+    // 需要记录投递时间时返回当前时间
+    Clock::time_point submitTime() const {
+        return this->isElastic || this->isTiming ? Clock::now() : Clock::time_point();
+    }
+
+    // 有线程休眠时唤醒最多 n 个
+    void notifyWorker(size_t n = 1);
+    // 当前线程是本线程池的工作线程时返回其任务队列，否则返回 nullptr
+    Worker* localWorker();
+
+    // 公共队列已满时按 method 腾出空位，返回 false 表示新任务不能入队
+    // 被挤掉的任务放入 dropped，由调用方解锁后销毁，任务析构时可能恢复等待它的协程
+    bool makeRoom(AddTaskMethod method, std::unique_lock<std::mutex>& lock, std::vector<Task>& dropped);
+
+    template<typename... T>
+    bool emplaceTask(const TaskOption& option, T&&... a) {
+        if(this->isStop) {
+            return false;
+        }
+        Worker* w = this->localWorker();
+        if(w && option.priority == Normal) {
+            // 任务内部投递的任务放入本线程队列
+            Clock::time_point t = this->submitTime();
+            w->dMutex.lock();
+            // 先计数再入队，任务一旦可见就可能被取走并减计数
+            this->addTaskNum(1);
+            w->d.emplace_back(t, option, std::forward<T>(a)...);
+            w->dMutex.unlock();
+        }
+        else {
+            std::vector<Task> dropped;
+            Clock::time_point t = Clock::now();
+            std::unique_lock<std::mutex> lock(this->qMutex);
+            if(this->isStop) {
+                return false;
+            }
+            // 任务内部投递的任务不受长度限制
+            AddTaskMethod method = w ? Push : option.method;
+            if(method != Push && this->qNum >= this->taskMaxNum && !this->makeRoom(method, lock, dropped)) {
+                lock.unlock();
+                if(method == CallerRuns) {
+                    Task(std::forward<T>(a)...)();
+                    return true;
+                }
+                return false;
+            }
+            this->addTaskNum(1);
+            this->q[option.priority].emplace(t, option, std::forward<T>(a)...);
+            ++this->qNum;
+            if(option.priority == High) {
+                ++this->highNum;
+            }
+        }
+        this->notifyWorker();
+        return true;
+    }
+
+    // 依次尝试 公共队列中的高优先级任务 -> 本线程队列 -> 公共队列 -> 其他线程队列
+    // 从公共队列取任务时顺便取一批 Normal 任务放入本线程队列
+    // 非工作线程调用 stealTask 时 index 为 MaxThreadNum
+    bool popTask(unsigned int index, TaskItem& item);
+    bool popShared(TaskItem& item);
+    bool stealTask(unsigned int index, TaskItem& item);
 
 };
 
+template<typename P>
+void ThreadPool::runUntil(P&& isDone) {
+    while(!isDone()) {
+        if(this->tryRunTask()) {
+            continue;
+        }
+        // 和空闲的工作线程一样计入 idleNum，投递任务时会被唤醒
+        std::unique_lock<std::mutex> lock(this->cvMutex);
+        ++this->idleNum;
+        this->cv.wait(lock, [this, &isDone]() {
+            return this->taskNum || isDone();
+        });
+        --this->idleNum;
+    }
+}
+
+template<typename It>
+requires std::constructible_from<Task, std::iter_rvalue_reference_t<It>>
+void ThreadPool::addTasks(It first, It last, const TaskOption& option) {
+    if(this->isStop || first == last) {
+        return;
+    }
+
+    size_t n = 0;
+    Worker* w = this->localWorker();
+    if(w && option.priority == Normal) {
+        Clock::time_point t = this->submitTime();
+        w->dMutex.lock();
+        for(;first!=last;++first) {
+            w->d.emplace_back(t, option, std::ranges::iter_move(first));
+            ++n;
+        }
+        this->addTaskNum(n);
+        w->dMutex.unlock();
+    }
+    else {
+        std::vector<Task> callerRuns;
+        std::vector<Task> dropped;
+        Clock::time_point t = Clock::now();
+        std::unique_lock<std::mutex> lock(this->qMutex);
+        if(this->isStop) {
+            return;
+        }
+        AddTaskMethod method = w ? Push : option.method;
+        // 已计入 taskNum 的任务数
+        size_t counted = 0;
+        for(;first!=last;++first) {
+            if(method != Push && this->qNum >= this->taskMaxNum) {
+                // Block 时 makeRoom 会解锁等待，已入队的任务可能被取走，先计数
+                this->addTaskNum(n - counted);
+                counted = n;
+                if(!this->makeRoom(method, lock, dropped)) {
+                    if(method == CallerRuns) {
+                        callerRuns.emplace_back(std::ranges::iter_move(first));
+                    }
+                    continue;
+                }
+            }
+            this->q[option.priority].emplace(t, option, std::ranges::iter_move(first));
+            ++this->qNum;
+            ++n;
+            if(option.priority == High) {
+                ++this->highNum;
+            }
+        }
+        this->addTaskNum(n - counted);
+        lock.unlock();
+
+        this->notifyWorker(n);
+        for(auto& task : callerRuns) {
+            task();
+        }
+        return;
+    }
+    this->notifyWorker(n);
 }
+
+}
+
+#include "future.hpp"
+#include "parallel.hpp"
+#include "coroutine.hpp"
+
+#endif // _THREAD_POOL_H_
@@ -0,0 +1,218 @@
+#include "timerWheel.hpp"
+
+#include <algorithm>
+
+shochu::TimerWheel::TimerWheel(std::function<void(Task&&)> post) :
+    post(std::move(post)),
+    startTime(Clock::now()),
+    curTick(0),
+    wakeTick(0),
+    pendingNum(0),
+    cancelledNum(std::make_shared<std::atomic<size_t>>(0)),
+    isQuit(false) {
+}
+
+shochu::TimerWheel::~TimerWheel() {
+    this->stop();
+}
+
+void shochu::TimerWheel::stop() {
+    std::unique_lock<std::mutex> l(this->m);
+    this->isQuit = true;
+    l.unlock();
+    this->cv.notify_all();
+    if(this->th.joinable()) {
+        this->th.join();
+    }
+
+    // 在锁外销毁定时器的任务，任务析构时可能恢复等待它的协程
+    std::vector<NodePtr> dropped;
+    l.lock();
+    for(auto& level : this->slots) {
+        for(auto& slot : level) {
+            dropped.insert(dropped.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+    }
+    this->pendingNum = 0;
+    l.unlock();
+}
+
+size_t shochu::TimerWheel::size() const {
+    std::lock_guard<std::mutex> l(this->m);
+    return this->pendingNum;
+}
+
+uint64_t shochu::TimerWheel::toTick(Clock::duration d) {
+    if(d <= Clock::duration::zero()) {
+        return 0;
+    }
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(d);
+    return static_cast<uint64_t>(ms.count());
+}
+
+uint64_t shochu::TimerWheel::nowTick() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - this->startTime).count();
+}
+
+bool shochu::TimerWheel::insert(const NodePtr& node, uint64_t delay, const std::function<void()>& init) {
+    std::unique_lock<std::mutex> l(this->m);
+    if(this->isQuit) {
+        return false;
+    }
+    if(init) {
+        init();
+    }
+    node->cancelledNum = this->cancelledNum;
+    if(this->pendingNum == 0) {
+        // 空闲期间没有推进 tick，直接跳到当前时间
+        this->curTick = std::max(this->curTick, this->nowTick());
+    }
+    // nowTick 向下取整，多加一个 tick 保证不会提前触发
+    node->expireTick = this->nowTick() + delay + (delay ? 1 : 0);
+    this->place(node);
+    ++this->pendingNum;
+
+    if(!this->th.joinable()) {
+        this->th = std::thread(&TimerWheel::run, this);
+    }
+    // 比内部线程计划醒来的时间更早时才需要唤醒
+    if(node->expireTick < this->wakeTick || this->pendingNum == 1) {
+        l.unlock();
+        this->cv.notify_one();
+    }
+    return true;
+}
+
+void shochu::TimerWheel::place(const NodePtr& node) {
+    uint64_t expire = std::max(node->expireTick, this->curTick);
+    uint64_t delta = expire - this->curTick;
+    for(int level=0;level<LevelNum;++level) {
+        if(delta < (uint64_t(1) << (SlotBits * (level + 1)))) {
+            this->slots[level][(expire >> (SlotBits * level)) & SlotMask].push_back(node);
+            return;
+        }
+    }
+    // 超出时间轮范围的先放在最高层最远的槽，级联时重新计算
+    expire = this->curTick + (uint64_t(1) << (SlotBits * LevelNum)) - 1;
+    this->slots[LevelNum - 1][(expire >> (SlotBits * (LevelNum - 1))) & SlotMask].push_back(node);
+}
+
+void shochu::TimerWheel::unlink(NodePtr&& node, std::vector<NodePtr>& dropped) {
+    uint8_t s = TimerHandle::Node::Linked;
+    if(!node->state.compare_exchange_strong(s, TimerHandle::Node::Unlinked)) {
+        // cancel 已经计入待回收数
+        node->state.store(TimerHandle::Node::Unlinked, std::memory_order_relaxed);
+        this->cancelledNum->fetch_sub(1, std::memory_order_relaxed);
+    }
+    --this->pendingNum;
+    dropped.push_back(std::move(node));
+}
+
+void shochu::TimerWheel::processTick(uint64_t tick, std::vector<Task>& fired, std::vector<NodePtr>& dropped) {
+    // 低层转完一圈时，把高层对应槽的定时器重新分配到低层，顺便移除已取消的
+    for(int level=1;level<LevelNum;++level) {
+        if(((tick >> (SlotBits * (level - 1))) & SlotMask) != 0) {
+            break;
+        }
+        std::vector<NodePtr> nodes;
+        nodes.swap(this->slots[level][(tick >> (SlotBits * level)) & SlotMask]);
+        for(auto& node : nodes) {
+            if(node->isCancel) {
+                this->unlink(std::move(node), dropped);
+            }
+            else {
+                this->place(node);
+            }
+        }
+    }
+    // 之后重新放入的定时器最早落在下一个 tick
+    this->curTick = tick + 1;
+
+    std::vector<NodePtr> nodes;
+    nodes.swap(this->slots[0][tick & SlotMask]);
+    for(auto& node : nodes) {
+        if(node->expireTick > tick) {
+            // 超出范围后放回的定时器
+            this->place(node);
+            continue;
+        }
+        if(node->isCancel) {
+            this->unlink(std::move(node), dropped);
+            continue;
+        }
+        if(node->periodTick) {
+            fired.push_back(node->make());
+            // 落后超过一个周期时跳过错过的触发，不补发
+            node->expireTick = std::max(node->expireTick + node->periodTick, this->curTick);
+            this->place(node);
+        }
+        else {
+            fired.push_back(std::move(node->task));
+            this->unlink(std::move(node), dropped);
+        }
+    }
+}
+
+void shochu::TimerWheel::sweep(std::vector<NodePtr>& dropped) {
+    for(auto& level : this->slots) {
+        for(auto& slot : level) {
+            auto it = std::partition(slot.begin(), slot.end(), [](const NodePtr& node) {
+                return !node->isCancel;
+            });
+            for(auto i=it;i!=slot.end();++i) {
+                this->unlink(std::move(*i), dropped);
+            }
+            slot.erase(it, slot.end());
+        }
+    }
+}
+
+uint64_t shochu::TimerWheel::nextTick() const {
+    // 只在本圈内查找，到一圈结束时需要级联，届时醒来
+    uint64_t end = (this->curTick | SlotMask) + 1;
+    for(uint64_t t=this->curTick;t<end;++t) {
+        if(!this->slots[0][t & SlotMask].empty()) {
+            return t;
+        }
+    }
+    return end;
+}
+
+void shochu::TimerWheel::run() {
+    std::vector<Task> fired;
+    std::vector<NodePtr> dropped;
+    std::unique_lock<std::mutex> l(this->m);
+    while(!this->isQuit) {
+        if(this->pendingNum == 0) {
+            this->wakeTick = UINT64_MAX;
+            this->cv.wait(l, [this]() {
+                return this->isQuit || this->pendingNum;
+            });
+            continue;
+        }
+
+        uint64_t now = this->nowTick();
+        while(this->curTick <= now) {
+            this->processTick(this->curTick, fired, dropped);
+        }
+        size_t cancelled = this->cancelledNum->load(std::memory_order_relaxed);
+        if(cancelled >= SweepMinNum && cancelled * 2 > this->pendingNum) {
+            this->sweep(dropped);
+        }
+        if(!fired.empty() || !dropped.empty()) {
+            // 在锁外销毁移除的定时器，任务析构时可能恢复等待它的协程
+            l.unlock();
+            for(auto& t : fired) {
+                this->post(std::move(t));
+            }
+            fired.clear();
+            dropped.clear();
+            l.lock();
+            continue;
+        }
+
+        this->wakeTick = this->nextTick();
+        this->cv.wait_until(l, this->startTime + std::chrono::milliseconds(this->wakeTick));
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include "task.hpp"
+
+/**
+ * @brief 分层时间轮
+ * 4 层，每层 256 个槽，精度 1ms，插入、取消和每个 tick 的处理都是 O(1)
+ * 到期的任务通过构造时传入的 post 投递执行，由一个内部线程驱动，
+ * 没有定时器时该线程一直休眠，有定时器时只在下一个非空槽到期时醒来
+ * 取消的定时器在级联或到期时移除，未回收的取消数超过定时器数的一半时整体清理一次，
+ * 大量取消远期定时器时内存不会一直增长
+ * @code {.cpp}
+ * auto h = ThreadPool::getInstance()->scheduleEvery(std::chrono::seconds(1), []() { ... });
+ * h.cancel();
+ * @endcode
+ */
+namespace shochu {
+
+class TimerWheel;
+
+class TimerHandle {
+public:
+    TimerHandle() {}
+
+    // 取消后不再触发，已经投递的任务不受影响
+    void cancel() {
+        if(!this->node) {
+            return;
+        }
+        this->node->isCancel = true;
+        // 仍在时间轮中时计入待回收数，与时间轮移除节点互斥，只有一方成功
+        uint8_t s = Node::Linked;
+        if(this->node->state.compare_exchange_strong(s, Node::Cancelled)) {
+            this->node->cancelledNum->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    bool isCancelled() const {
+        return this->node && this->node->isCancel;
+    }
+    bool valid() const {
+        return this->node != nullptr;
+    }
+
+private:
+    friend class TimerWheel;
+
+    struct Node {
+        enum State : uint8_t {
+            Linked,
+            Cancelled,  // 已经计入 cancelledNum，还在时间轮中
+            Unlinked
+        };
+
+        uint64_t expireTick;
+        // 0 表示只触发一次
+        uint64_t periodTick;
+        std::atomic<bool> isCancel{false};
+        std::atomic<uint8_t> state{Linked};
+        // 时间轮中已取消但还未移除的定时器数，时间轮析构后仍可能被 cancel 访问
+        std::shared_ptr<std::atomic<size_t>> cancelledNum;
+        // 只触发一次的任务
+        Task task;
+        // 周期任务每次触发时生成一个任务
+        std::function<Task()> make;
+    };
+
+    explicit TimerHandle(std::shared_ptr<Node> n) : node(std::move(n)) {}
+
+    std::shared_ptr<Node> node;
+};
+
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(std::function<void(Task&&)> post);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    ~TimerWheel();
+
+    // delay 向上取整到 1ms，已经 stop 时返回无效的句柄，f 不会被移走
+    template<typename F>
+    TimerHandle after(Clock::duration delay, F&& f) {
+        auto node = std::make_shared<TimerHandle::Node>();
+        node->periodTick = 0;
+        bool ok = this->insert(node, toTick(delay), [&node, &f]() {
+            node->task = Task(std::forward<F>(f));
+        });
+        return ok ? TimerHandle(node) : TimerHandle();
+    }
+
+    // 固定频率触发，第一次在 period 之后，上一次还没执行完时也会照常投递
+    template<typename F>
+    TimerHandle every(Clock::duration period, F&& f) {
+        auto fn = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+        auto node = std::make_shared<TimerHandle::Node>();
+        node->periodTick = std::max<uint64_t>(1, toTick(period));
+        node->make = [fn]() {
+            return Task([fn]() {
+                (*fn)();
+            });
+        };
+        return this->insert(node, node->periodTick) ? TimerHandle(node) : TimerHandle();
+    }
+
+    // 停止内部线程，未到期的定时器全部丢弃
+    void stop();
+
+    // 尚未触发（包括已取消但还未回收）的定时器数
+    size_t size() const;
+
+private:
+    static constexpr int LevelNum = 4;
+    static constexpr int SlotBits = 8;
+    static constexpr uint64_t SlotNum = 1 << SlotBits;
+    static constexpr uint64_t SlotMask = SlotNum - 1;
+
+    // 待回收的取消数不少于该值且超过一半时整体清理
+    static constexpr size_t SweepMinNum = 64;
+
+    using NodePtr = std::shared_ptr<TimerHandle::Node>;
+
+    std::function<void(Task&&)> post;
+    Clock::time_point startTime;
+
+    mutable std::mutex m;
+    std::condition_variable cv;
+    std::vector<NodePtr> slots[LevelNum][SlotNum];
+    // 小于 curTick 的 tick 都已处理
+    uint64_t curTick;
+    // 内部线程下次醒来的 tick
+    uint64_t wakeTick;
+    size_t pendingNum;
+    std::shared_ptr<std::atomic<size_t>> cancelledNum;
+    bool isQuit;
+    std::thread th;
+
+    static uint64_t toTick(Clock::duration d);
+    uint64_t nowTick() const;
+
+    // 已经 stop 时返回 false，否则在锁内调用 init 后插入
+    bool insert(const NodePtr& node, uint64_t delay, const std::function<void()>& init = nullptr);
+    // 持有 m 时调用
+    void place(const NodePtr& node);
+    // 持有 m 时调用，把节点移出时间轮，节点放入 dropped 在锁外销毁
+    void unlink(NodePtr&& node, std::vector<NodePtr>& dropped);
+    void processTick(uint64_t tick, std::vector<Task>& fired, std::vector<NodePtr>& dropped);
+    void sweep(std::vector<NodePtr>& dropped);
+    uint64_t nextTick() const;
+    void run();
+};
+
+}
+
+#endif // _TIMER_WHEEL_H_
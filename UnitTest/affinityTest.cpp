@@ -0,0 +1,112 @@
+#include <set>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+struct WorkerInfo{
+    std::string name;
+    int cpuNum;
+};
+
+// 同时在 n 个工作线程中读取线程名和可用的核数
+// 最多等待10秒，超时返回的结果不足 n 个；状态由任务共享，超时返回后仍在运行的任务不会访问已释放的栈
+std::vector<WorkerInfo> collect(ThreadPool* p, int n){
+    struct State{
+        std::mutex m;
+        std::vector<WorkerInfo> infos;
+        std::atomic<int> arrived{0};
+        std::atomic<int> left{0};
+    };
+    auto state = std::make_shared<State>();
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    for(int i=0;i<n;++i){
+        p->addTask([n, state, deadline](){
+            ++state->arrived;
+            while(state->arrived.load() < n && Clock::now() < deadline){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            char name[16] = {0};
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+            {
+                std::lock_guard<std::mutex> l(state->m);
+                state->infos.push_back(WorkerInfo{name, CPU_COUNT(&set)});
+            }
+            ++state->left;
+        });
+    }
+    while(state->left.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> l(state->m);
+    return state->infos;
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(2);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int allowedNum = CPU_COUNT(&allowed);
+
+    // 工作线程名为 shochu-pool-<编号>
+    std::set<std::string> names;
+    for(auto& info : collect(p, 2)){
+        names.insert(info.name);
+    }
+    Expect_EQ(names.size(), size_t(2));
+    Expect_EQ(names.count("shochu-pool-0"), size_t(1));
+    Expect_EQ(names.count("shochu-pool-1"), size_t(1));
+
+    // PinCore：每个线程只能在一个核上运行
+    p->setAffinity(ThreadPool::PinCore);
+    int pinnedNum = 0;
+    for(auto& info : collect(p, 2)){
+        pinnedNum += info.cpuNum == 1;
+    }
+    Expect_EQ(pinnedNum, 2);
+
+    // 之后新建的线程同样生效
+    p->setThreadNum(3);
+    pinnedNum = 0;
+    for(auto& info : collect(p, 3)){
+        pinnedNum += info.cpuNum == 1;
+    }
+    Expect_EQ(pinnedNum, 3);
+
+    // PinNode：绑定到节点的所有核，不超过进程可用的核
+    p->setAffinity(ThreadPool::PinNode);
+    int inRangeNum = 0;
+    for(auto& info : collect(p, 3)){
+        inRangeNum += info.cpuNum >= 1 && info.cpuNum <= allowedNum;
+    }
+    Expect_EQ(inRangeNum, 3);
+
+    // NoAffinity：恢复为进程可用的所有核
+    p->setAffinity(ThreadPool::NoAffinity);
+    int restoredNum = 0;
+    for(auto& info : collect(p, 3)){
+        restoredNum += info.cpuNum == allowedNum;
+    }
+    Expect_EQ(restoredNum, 3);
+    Run_All_TestCase();
+
+    return 0;
+}
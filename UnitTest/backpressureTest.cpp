@@ -0,0 +1,92 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    const int threadNum = 4;
+    p->setThreadNum(threadNum);
+
+    // 所有工作线程都被占住，后面的任务都留在公共队列中
+    std::atomic<int> startedNum{0};
+    std::atomic<bool> isRelease{false};
+    for(int i=0;i<threadNum;++i){
+        p->addTask([&startedNum, &isRelease](){
+            ++startedNum;
+            while(!isRelease.load()){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(startedNum.load() < threadNum && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_EQ(startedNum.load(), threadNum);
+    p->setTaskMaxNum(2);
+    std::atomic<int> oldestRun{0};
+    std::atomic<int> ran{0};
+    p->addTask([&oldestRun](){ ++oldestRun; });
+    p->addTask([&ran](){ ++ran; });
+
+    // Discard：拒绝新任务
+    std::atomic<int> discardRun{0};
+    p->addTask(ThreadPool::Discard, [&discardRun](){ ++discardRun; });
+
+    // DiscardOldest：丢弃最早的任务，新任务入队
+    p->addTask(ThreadPool::DiscardOldest, [&ran](){ ++ran; });
+
+    // CallerRuns：在投递线程中直接执行
+    std::thread::id runner;
+    p->addTask(ThreadPool::CallerRuns, [&runner](){ runner = std::this_thread::get_id(); });
+    Expect_True(runner == std::this_thread::get_id());
+
+    // Block 超时后丢弃
+    p->setBlockTimeout(std::chrono::milliseconds(50));
+    auto begin = Clock::now();
+    p->addTask(ThreadPool::Block, [&discardRun](){ ++discardRun; });
+    long waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+    Expect_GE(waitMs, 50L);
+
+    // Block 一直等待，直到有空位
+    p->setBlockTimeout(std::chrono::milliseconds(-1));
+    std::atomic<bool> isBlockAdded{false};
+    std::thread producer([p, &ran, &isBlockAdded](){
+        p->addTask(ThreadPool::Block, [&ran](){ ++ran; });
+        isBlockAdded = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool isBlocked = !isBlockAdded.load();
+    Expect_True(isBlocked);
+
+    // Push 不受上限限制
+    p->addTask([&ran](){ ++ran; });
+
+    isRelease = true;
+    producer.join();
+    Expect_True(isBlockAdded.load());
+    deadline = Clock::now() + std::chrono::seconds(5);
+    while(ran.load() < 4 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_EQ(ran.load(), 4);
+    Expect_EQ(oldestRun.load(), 0);
+    Expect_EQ(discardRun.load(), 0);
+
+    ThreadPool::OverflowStat s = p->getOverflowStat();
+    Expect_EQ(s.discardNum, size_t(1));
+    Expect_EQ(s.discardOldestNum, size_t(1));
+    Expect_EQ(s.callerRunsNum, size_t(1));
+    Expect_EQ(s.blockNum, size_t(2));
+    Expect_EQ(s.blockTimeoutNum, size_t(1));
+    Run_All_TestCase();
+
+    return 0;
+}
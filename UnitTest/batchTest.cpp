@@ -0,0 +1,102 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(2);
+
+    // 整批投递，元素被移走
+    std::atomic<int> cnt{0};
+    std::vector<Task> tasks;
+    for(int i=0;i<1000;++i){
+        tasks.emplace_back([&cnt](){ ++cnt; });
+    }
+    p->addTasks(tasks);
+    waitCount(cnt, 1000);
+    Expect_EQ(cnt.load(), 1000);
+    int validNum = 0;
+    for(auto& t : tasks){
+        validNum += bool(t);
+    }
+    Expect_EQ(validNum, 0);
+
+    // 迭代器区间，元素可以是其他可调用对象
+    cnt = 0;
+    std::vector<std::function<void()>> funcs(100, [&cnt](){ ++cnt; });
+    p->addTasks(funcs.begin(), funcs.end());
+    waitCount(cnt, 100);
+    Expect_EQ(cnt.load(), 100);
+
+    // 在任务内部投递的一批进入本线程队列
+    cnt = 0;
+    p->addTask([p, &cnt](){
+        std::vector<Task> inner;
+        for(int i=0;i<500;++i){
+            inner.emplace_back([&cnt](){ ++cnt; });
+        }
+        p->addTasks(inner);
+    });
+    waitCount(cnt, 500);
+    Expect_EQ(cnt.load(), 500);
+
+    // 公共队列满时超出的任务逐个按 option.method 处理
+    p->setThreadNum(1);
+    p->setPopBatchNum(0);
+    std::atomic<bool> isStarted{false};
+    std::atomic<bool> isRelease{false};
+    p->addTask([&isStarted, &isRelease](){
+        isStarted = true;
+        while(!isRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(!isStarted.load() && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_True(isStarted.load());
+    p->setTaskMaxNum(10);
+    cnt = 0;
+    tasks.clear();
+    for(int i=0;i<15;++i){
+        tasks.emplace_back([&cnt](){ ++cnt; });
+    }
+    size_t discardBefore = p->getOverflowStat().discardNum;
+    p->addTasks(tasks, ThreadPool::Discard);
+    size_t discardNum = p->getOverflowStat().discardNum - discardBefore;
+    Expect_EQ(discardNum, size_t(5));
+    isRelease = true;
+    waitCount(cnt, 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(cnt.load(), 10);
+
+    // 执行线程每次从公共队列多取一批任务
+    p->setPopBatchNum(16);
+    cnt = 0;
+    tasks.clear();
+    for(int i=0;i<10000;++i){
+        tasks.emplace_back([&cnt](){ ++cnt; });
+    }
+    p->addTasks(tasks);
+    waitCount(cnt, 10000);
+    Expect_EQ(cnt.load(), 10000);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 占住唯一的工作线程，之后投递的任务都在排队
+class Gate{
+public:
+    explicit Gate(ThreadPool* p) : isStarted(false), isRelease(false){
+        p->addTask(CancelToken::none(), [this](){
+            this->isStarted = true;
+            while(!this->isRelease.load()){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while(!this->isStarted.load() && Clock::now() < deadline){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Expect_True(this->isStarted.load());
+    }
+    void release(){
+        this->isRelease = true;
+    }
+
+private:
+    std::atomic<bool> isStarted;
+    std::atomic<bool> isRelease;
+};
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(1);
+
+    // 取消后尚未开始的任务不再执行，Future 以 broken_promise 完成
+    CancelSource src;
+    std::atomic<int> ran{0};
+    std::atomic<int> other{0};
+    Future<int> f;
+    {
+        Gate g(p);
+        for(int i=0;i<10;++i){
+            p->addTask(src.token(), [&ran](){ ++ran; });
+        }
+        f = p->submit(ThreadPool::TaskOption(src.token()), [](){ return 1; });
+        p->addTask([&other](){ ++other; });
+        src.cancel();
+        g.release();
+    }
+    waitCount(other, 1);
+    bool isBroken = false;
+    try{
+        f.get();
+    }
+    catch(const std::future_error& e){
+        isBroken = e.code() == std::future_errc::broken_promise;
+    }
+    Expect_EQ(ran.load(), 0);
+    Expect_EQ(other.load(), 1);
+    Expect_True(isBroken);
+    Expect_EQ(p->getCancelledNum(), size_t(11));
+
+    // 正在执行的任务通过轮询当前令牌退出
+    CancelSource longSrc;
+    std::atomic<bool> isStarted{false};
+    std::atomic<int> exited{0};
+    p->addTask(longSrc.token(), [&isStarted, &exited](){
+        isStarted = true;
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while(!CancelToken::current().isCancelled() && Clock::now() < deadline){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if(CancelToken::current().isCancelled()){
+            ++exited;
+        }
+    });
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(!isStarted.load() && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_True(isStarted.load());
+    longSrc.cancel();
+    waitCount(exited, 1);
+    Expect_EQ(exited.load(), 1);
+
+    // 作用域内投递的任务和任务内部投递的任务都带上令牌，none() 不受影响
+    CancelSource scopeSrc;
+    std::atomic<int> scoped{0};
+    std::atomic<int> detached{0};
+    {
+        Gate g(p);
+        {
+            CancelScope scope(scopeSrc.token());
+            p->addTask([&scoped](){ ++scoped; });
+            p->addTask(CancelToken::none(), [&detached](){ ++detached; });
+        }
+        g.release();
+    }
+    waitCount(detached, 1);
+    Expect_EQ(scoped.load(), 1);
+
+    CancelSource parentSrc;
+    std::atomic<int> child{0};
+    std::atomic<int> childQueued{0};
+    p->addTask(parentSrc.token(), [p, &parentSrc, &child, &childQueued](){
+        p->addTask([&child](){ ++child; });
+        // 子任务还在本线程队列中时取消
+        parentSrc.cancel();
+        ++childQueued;
+    });
+    waitCount(childQueued, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(child.load(), 0);
+
+    scopeSrc.cancel();
+    {
+        Gate g(p);
+        {
+            CancelScope scope(scopeSrc.token());
+            p->addTask([&scoped](){ ++scoped; });
+            p->addTask(CancelToken::none(), [&detached](){ ++detached; });
+        }
+        g.release();
+    }
+    waitCount(detached, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(scoped.load(), 1);
+    Expect_EQ(detached.load(), 2);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+struct Quote{
+    uint64_t id;
+    int price;
+};
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // 订阅者处理第一条消息时阻塞，期间每个 key 只保留最新的一条
+    mq->setDispatchMode("quote", MessageQueue::Pooled);
+    mq->setConflation<Quote>("quote", [](const Quote& q){ return q.id; });
+    std::atomic<bool> isRelease{false};
+    std::atomic<int> slowNum{0};
+    std::atomic<int> fullNum{0};
+    std::mutex m;
+    std::unordered_map<uint64_t, int> latest;
+    mq->subscribe<Quote>("quote", [&isRelease, &slowNum, &m, &latest](const Quote& q){
+        while(!isRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> l(m);
+        latest[q.id] = q.price;
+        ++slowNum;
+    });
+    mq->post("quote", Quote{0, -1});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for(int i=0;i<100;++i){
+        for(uint64_t id=0;id<3;++id){
+            mq->post("quote", Quote{id, i});
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    isRelease = true;
+    waitCount(slowNum, 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(slowNum.load(), 4);
+    Expect_EQ(mq->getCoalescedNum("quote"), uint64_t(297));
+    int latestNum = 0;
+    {
+        std::lock_guard<std::mutex> l(m);
+        for(uint64_t id=0;id<3;++id){
+            latestNum += latest.count(id) && latest[id] == 99;
+        }
+    }
+    Expect_EQ(latestNum, 3);
+
+    // 处理得及时的订阅者收到每一条消息
+    mq->subscribe<Quote>("quote", [&fullNum](const Quote&){ ++fullNum; });
+    slowNum = 0;
+    for(int i=0;i<100;++i){
+        mq->post("quote", Quote{uint64_t(i), i});
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    waitCount(fullNum, 100);
+    waitCount(slowNum, 100);
+    Expect_EQ(fullNum.load(), 100);
+    Expect_EQ(slowNum.load(), 100);
+
+    // 负载不是 T 的消息不合并
+    std::atomic<int> otherNum{0};
+    mq->subscribe<int>("quote", [&otherNum](const int&){ ++otherNum; });
+    for(int i=0;i<10;++i){
+        mq->post("quote", i);
+    }
+    waitCount(otherNum, 10);
+    Expect_EQ(otherNum.load(), 10);
+
+    // 以 Event 字段为 key，Dedicated 方式
+    mq->setDispatchMode("quote/event", MessageQueue::Dedicated);
+    mq->setConflation("quote/event", "symbol");
+    std::atomic<bool> isEventRelease{false};
+    std::atomic<int> eventNum{0};
+    std::string lastSymbol;
+    int lastPrice = 0;
+    mq->registerSubscripter("quote/event", [&isEventRelease, &eventNum, &lastSymbol, &lastPrice](Event e){
+        while(!isEventRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        lastSymbol = std::any_cast<std::string>(e["symbol"]);
+        lastPrice = std::any_cast<int>(e["price"]);
+        ++eventNum;
+    });
+    for(int i=0;i<50;++i){
+        Event e("quote/event");
+        e["symbol"] = std::string("abc");
+        e["price"] = i;
+        mq->postMessage(std::move(e));
+        if(i == 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    isEventRelease = true;
+    waitCount(eventNum, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(eventNum.load(), 2);
+    Expect_StrEQ(lastSymbol, "abc");
+    Expect_EQ(lastPrice, 49);
+    Expect_EQ(mq->getCoalescedNum("quote/event"), uint64_t(48));
+
+    // Inline 方式、重复设置、设置后切换为 Inline 时抛出 std::invalid_argument
+    int errorNum = 0;
+    try{
+        mq->setConflation<Quote>("quote/inline", [](const Quote& q){ return q.id; });
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    try{
+        mq->setConflation<Quote>("quote", [](const Quote& q){ return q.id; });
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    try{
+        mq->setDispatchMode("quote", MessageQueue::Inline);
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    Expect_EQ(errorNum, 3);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include <pthread.h>
+
+#include "unittest.hpp"
+#include "../ThreadPool/coroutine.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+std::string threadName(){
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    return name;
+}
+
+// schedule 之后在工作线程中继续执行
+CoTask<std::string> nameAfterSchedule(ThreadPool* p){
+    co_await p->schedule();
+    co_return threadName();
+}
+
+CoTask<int> addLater(ThreadPool* p, int a){
+    int b = co_await p->submit([](){ return 2; });
+    co_return a + b;
+}
+
+// 等待另一个协程
+CoTask<int> nested(ThreadPool* p){
+    int x = co_await addLater(p, 1);
+    int y = co_await addLater(p, 10);
+    co_return x + y;
+}
+
+CoTask<long> sleepMs(long ms){
+    auto begin = Clock::now();
+    co_await sleepFor(std::chrono::milliseconds(ms));
+    co_return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+}
+
+CoTask<int> throwAfterSchedule(ThreadPool* p){
+    co_await p->schedule();
+    throw std::runtime_error("in coroutine");
+    co_return 0;
+}
+
+CoTask<> count(ThreadPool* p, std::atomic<int>& cnt){
+    co_await p->schedule();
+    co_await sleepFor(std::chrono::milliseconds(1));
+    ++cnt;
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(2);
+
+    std::string name = syncWait(nameAfterSchedule(p));
+    Expect_StrEQ(name.substr(0, 12), "shochu-pool-");
+
+    // 等待 Future 和其他协程
+    Expect_EQ(syncWait(addLater(p, 40)), 42);
+    Expect_EQ(syncWait(nested(p)), 15);
+
+    // sleepFor 不会提前恢复
+    long slept = syncWait(sleepMs(20));
+    Expect_GE(slept, 20L);
+
+    // 协程中抛出的异常由 syncWait 重新抛出
+    std::string what;
+    try{
+        syncWait(throwAfterSchedule(p));
+    }
+    catch(const std::runtime_error& e){
+        what = e.what();
+    }
+    Expect_StrEQ(what, "in coroutine");
+
+    // toFuture 转为 Future，大量协程同时挂起
+    std::atomic<int> cnt{0};
+    std::vector<Future<void>> fs;
+    for(int i=0;i<1000;++i){
+        fs.push_back(toFuture(count(p, cnt)));
+    }
+    whenAll(std::move(fs)).get();
+    Expect_EQ(cnt.load(), 1000);
+
+    // 惰性执行：没有被等待的协程不会开始
+    std::atomic<int> started{0};
+    {
+        auto t = count(p, started);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    Expect_EQ(started.load(), 0);
+    Run_All_TestCase();
+
+    return 0;
+}
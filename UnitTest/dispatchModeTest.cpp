@@ -0,0 +1,108 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 检查同一订阅者不会被并发调用，且收到的顺序与投递顺序一致
+struct Checker{
+    std::atomic<int> inside{0};
+    std::atomic<int> overlapNum{0};
+    std::atomic<int> misorderNum{0};
+    std::atomic<int> received{0};
+    int last = -1;
+
+    void onMessage(int v, std::chrono::milliseconds cost){
+        if(++this->inside > 1){
+            ++this->overlapNum;
+        }
+        if(v != this->last + 1){
+            ++this->misorderNum;
+        }
+        this->last = v;
+        std::this_thread::sleep_for(cost);
+        --this->inside;
+        ++this->received;
+    }
+};
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 消息的值放在 "v" 中
+void post(MessageQueue* mq, const std::string& topic, const std::any& v){
+    Event e(topic);
+    e["v"] = v;
+    mq->postMessage(std::move(e));
+}
+
+int main(){
+    ThreadPool::getInstance()->setThreadNum(4);
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // Pooled：不同订阅者在线程池中并行，同一订阅者按顺序
+    mq->setDispatchMode("mode/pooled", MessageQueue::Pooled);
+    Checker a;
+    Checker b;
+    mq->registerSubscripter("mode/pooled", [&a](Event e){ a.onMessage(std::any_cast<int>(e["v"]), std::chrono::milliseconds(20)); });
+    mq->registerSubscripter("mode/pooled", [&b](Event e){ b.onMessage(std::any_cast<int>(e["v"]), std::chrono::milliseconds(20)); });
+    auto begin = Clock::now();
+    for(int i=0;i<10;++i){
+        post(mq, "mode/pooled", i);
+    }
+    waitCount(a.received, 10);
+    waitCount(b.received, 10);
+    long pooledMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+    Expect_EQ(a.received.load() + b.received.load(), 20);
+    Expect_EQ(a.overlapNum.load() + b.overlapNum.load(), 0);
+    Expect_EQ(a.misorderNum.load() + b.misorderNum.load(), 0);
+    // 串行需要 400ms
+    Expect_LT(pooledMs, 380L);
+
+    // Dedicated：慢 topic 在自己的线程中处理，不阻塞 Inline topic
+    mq->setDispatchMode("mode/dedicated", MessageQueue::Dedicated);
+    Checker slow;
+    mq->registerSubscripter("mode/dedicated", [&slow](Event e){ slow.onMessage(std::any_cast<int>(e["v"]), std::chrono::milliseconds(100)); });
+    std::atomic<long> inlineMs{-1};
+    mq->registerSubscripter("mode/inline", [&inlineMs](Event e){
+        Clock::time_point t = std::any_cast<Clock::time_point>(e["v"]);
+        inlineMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t).count();
+    });
+    for(int i=0;i<3;++i){
+        post(mq, "mode/dedicated", i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    post(mq, "mode/inline", Clock::now());
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(inlineMs.load() < 0 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_GE(inlineMs.load(), 0L);
+    Expect_LT(inlineMs.load(), 50L);
+    waitCount(slow.received, 3);
+    Expect_EQ(slow.received.load(), 3);
+    Expect_EQ(slow.misorderNum.load(), 0);
+
+    // 已经设置 Pooled 的 topic 可以切回 Inline，消息照常送达
+    mq->setDispatchMode("mode/pooled", MessageQueue::Inline);
+    for(int i=10;i<20;++i){
+        post(mq, "mode/pooled", i);
+    }
+    waitCount(a.received, 20);
+    waitCount(b.received, 20);
+    Expect_EQ(a.received.load() + b.received.load(), 40);
+    Expect_EQ(a.misorderNum.load() + b.misorderNum.load(), 0);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 进程已使用的 CPU 时间（毫秒）
+long cpuMs(){
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1000 + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1000;
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+    std::atomic<long> latencyUs{-1};
+    Clock::time_point postTime;
+    mq->registerSubscripter("wakeup/test", [&latencyUs, &postTime](Event){
+        latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - postTime).count();
+    });
+
+    // 分发线程空闲时休眠，不轮询
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    long before = cpuMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long idleCpu = cpuMs() - before;
+    Expect_LT(idleCpu, 50L);
+
+    // 空闲一段时间后投递，订阅者立即收到
+    long maxLatencyUs = 0;
+    int missNum = 0;
+    for(int i=0;i<20;++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        latencyUs = -1;
+        postTime = Clock::now();
+        mq->postMessage(Event("wakeup/test"));
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while(latencyUs.load() < 0 && Clock::now() < deadline){
+            std::this_thread::yield();
+        }
+        // 超时没有收到的计为丢失，不参与延迟统计
+        long us = latencyUs.load();
+        if(us < 0){
+            ++missNum;
+            continue;
+        }
+        maxLatencyUs = std::max(maxLatencyUs, us);
+    }
+    Expect_EQ(missNum, 0);
+    Expect_LT(maxLatencyUs, 20000L);
+
+    // 连续投递的消息全部送达
+    std::atomic<int> cnt{0};
+    mq->subscribe<int>("wakeup/burst", [&cnt](const int&){ ++cnt; });
+    for(int i=0;i<100000;++i){
+        mq->post("wakeup/burst", i);
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < 100000 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_EQ(cnt.load(), 100000);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <string>
+#include <vector>
+#include <future>
+#include <stdexcept>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(2);
+
+    // 返回值和参数
+    Future<int> f = p->submit([](int a, int b){ return a + b; }, 1, 2);
+    Expect_True(f.valid());
+    Expect_EQ(f.get(), 3);
+
+    // 任务抛出的异常在 get 时重新抛出
+    Future<int> e = p->submit([]() -> int { throw std::runtime_error("boom"); });
+    std::string what;
+    try{
+        e.get();
+    }
+    catch(const std::runtime_error& err){
+        what = err.what();
+    }
+    Expect_StrEQ(what, "boom");
+
+    // then 串联，异常直接传递给后续的 Future
+    std::string s = p->submit([](){ return 21; })
+                     .then([](int v){ return v * 2; })
+                     .then([](int v){ return std::to_string(v); })
+                     .get();
+    Expect_StrEQ(s, "42");
+    bool isSkipped = true;
+    Future<void> chain = p->submit([]() -> int { throw std::logic_error("first"); })
+                          .then([&isSkipped](int){ isSkipped = false; });
+    what.clear();
+    try{
+        chain.get();
+    }
+    catch(const std::logic_error& err){
+        what = err.what();
+    }
+    Expect_StrEQ(what, "first");
+    Expect_True(isSkipped);
+
+    // whenAll 按输入顺序返回结果
+    std::vector<Future<int>> fs;
+    for(int i=0;i<10;++i){
+        fs.push_back(p->submit([i](){ return i * i; }));
+    }
+    std::vector<int> vals = whenAll(std::move(fs)).get();
+    int sum = 0;
+    for(int i=0;i<10;++i){
+        sum += vals[i] == i * i;
+    }
+    Expect_EQ(vals.size(), size_t(10));
+    Expect_EQ(sum, 10);
+
+    // whenAny 以第一个完成的结果完成
+    Promise<int> never;
+    std::vector<Future<int>> anys;
+    anys.push_back(never.getFuture());
+    anys.push_back(p->submit([](){ return 7; }));
+    std::pair<size_t, int> first = whenAny(std::move(anys)).get();
+    Expect_EQ(first.first, size_t(1));
+    Expect_EQ(first.second, 7);
+    never.setValue(0);
+
+    // 没有返回值的任务
+    int ran = 0;
+    p->submit([&ran](){ ran = 1; }).get();
+    Expect_EQ(ran, 1);
+
+    // 线程池停止后投递的任务被丢弃，Future 以 broken_promise 完成
+    p->shutdown();
+    Future<int> dropped = p->submit([](){ return 1; });
+    bool isBroken = false;
+    try{
+        dropped.get();
+    }
+    catch(const std::future_error& err){
+        isBroken = err.code() == std::future_errc::broken_promise;
+    }
+    Expect_True(isBroken);
+    Run_All_TestCase();
+
+    return 0;
+}
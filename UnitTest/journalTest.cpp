@@ -0,0 +1,125 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <filesystem>
+
+#include "unittest.hpp"
+#include "../MessageQueue/journal.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample{
+    uint64_t id;
+    double value;
+};
+
+int main(){
+    char tmpl[] = "/tmp/journalTestXXXXXX";
+    std::string root = mkdtemp(tmpl);
+    JournalOption option;
+    option.dir = root + "/direct";
+    // 小段文件，测试跨段写入和回放
+    option.segmentSize = 4096;
+    option.syncInterval = std::chrono::milliseconds(1);
+
+    // 追加后按序号回放，跨多个段
+    {
+        Journal j(option, &messageTypeTag<Sample>, sizeof(Sample));
+        for(uint64_t i=0;i<1000;++i){
+            Sample s{i, i * 0.5};
+            j.append(&s);
+        }
+        Expect_EQ(j.nextSeq(), uint64_t(1000));
+        int correct = 0;
+        uint64_t next = j.replay(0, [&correct](uint64_t seq, int64_t, const void* p){
+            const Sample* s = static_cast<const Sample*>(p);
+            correct += s->id == seq && s->value == seq * 0.5;
+        });
+        Expect_EQ(correct, 1000);
+        Expect_EQ(next, uint64_t(1000));
+        uint64_t first = UINT64_MAX;
+        int tailNum = 0;
+        j.replay(990, [&first, &tailNum](uint64_t seq, int64_t, const void*){
+            first = std::min(first, seq);
+            ++tailNum;
+        });
+        Expect_EQ(first, uint64_t(990));
+        Expect_EQ(tailNum, 10);
+    }
+
+    // 重新打开后恢复序号，继续追加
+    {
+        Journal j(option, &messageTypeTag<Sample>, sizeof(Sample));
+        Expect_EQ(j.nextSeq(), uint64_t(1000));
+        Sample s{1000, 500.0};
+        j.append(&s);
+        Expect_EQ(j.nextSeq(), uint64_t(1001));
+        int num = 0;
+        j.replay(0, [&num](uint64_t, int64_t, const void*){ ++num; });
+        Expect_EQ(num, 1001);
+    }
+
+    // MessageQueue：分发时写入日志，订阅者收到全部消息后回放得到同样的记录
+    MessageQueue* mq = MessageQueue::getInstance();
+    JournalOption mqOption;
+    mqOption.dir = root + "/mq";
+    mqOption.segmentSize = 4096;
+    mq->enableJournal<Sample>("journal/sample", mqOption);
+    std::atomic<int> received{0};
+    mq->subscribe<Sample>("journal/sample", [&received](const Sample&){ ++received; });
+    for(uint64_t i=0;i<2000;++i){
+        mq->post("journal/sample", Sample{i, 0});
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(received.load() < 2000 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_EQ(received.load(), 2000);
+    int inOrder = 0;
+    uint64_t next = mq->replay<Sample>("journal/sample", 0, [&inOrder](uint64_t seq, const Sample& s){
+        inOrder += seq == s.id;
+    });
+    Expect_EQ(inOrder, 2000);
+    Expect_EQ(next, uint64_t(2000));
+
+    // replaySince 只回放不早于给定时间的记录
+    int futureNum = 0;
+    mq->replaySince<Sample>("journal/sample", std::chrono::system_clock::now() + std::chrono::hours(1), [&futureNum](uint64_t, const Sample&){
+        ++futureNum;
+    });
+    Expect_EQ(futureNum, 0);
+
+    // 类型不符、没有开启日志、重复开启时抛出 std::invalid_argument
+    int errorNum = 0;
+    try{
+        mq->replay<uint32_t>("journal/sample", 0, [](uint64_t, const uint32_t&){});
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    try{
+        mq->replay<Sample>("journal/none", 0, [](uint64_t, const Sample&){});
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    try{
+        mq->enableJournal<Sample>("journal/sample", mqOption);
+    }
+    catch(const std::invalid_argument&){
+        ++errorNum;
+    }
+    Expect_EQ(errorNum, 3);
+    Run_All_TestCase();
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
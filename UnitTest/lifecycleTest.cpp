@@ -0,0 +1,95 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 同时投递 n 个互相等待的任务，全部同时在运行时返回 true
+bool runConcurrently(ThreadPool* p, int n){
+    std::atomic<int> arrived{0};
+    std::atomic<int> left{0};
+    std::atomic<bool> isTimeout{false};
+    for(int i=0;i<n;++i){
+        p->addTask([n, &arrived, &left, &isTimeout](){
+            ++arrived;
+            auto deadline = Clock::now() + std::chrono::seconds(2);
+            while(arrived.load() < n && Clock::now() < deadline){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if(arrived.load() < n){
+                isTimeout = true;
+            }
+            ++left;
+        });
+    }
+    waitCount(left, n);
+    return left.load() == n && !isTimeout.load();
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+
+    // 增加线程后可以同时运行更多任务
+    p->setThreadNum(4);
+    Expect_EQ(p->getThreadNum(), 4u);
+    Expect_True(runConcurrently(p, 4));
+
+    // 减少线程，多出的线程退出
+    p->setThreadNum(1);
+    Expect_EQ(p->getThreadNum(), 1u);
+    // 等多出的线程退出后，两个任务无法同时运行
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    Expect_False(runConcurrently(p, 2));
+    std::atomic<int> cnt{0};
+    for(int i=0;i<100;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    waitCount(cnt, 100);
+    Expect_EQ(cnt.load(), 100);
+
+    // 弹性线程数：取到排队过久的任务时增加线程，空闲后退回最小值
+    p->setElastic(ThreadPool::ElasticConfig{1, 4, std::chrono::microseconds(1000), std::chrono::milliseconds(50)});
+    cnt = 0;
+    p->addTask([&cnt](){
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++cnt;
+    });
+    for(int i=0;i<10;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    waitCount(cnt, 11);
+    Expect_EQ(cnt.load(), 11);
+    unsigned int grownNum = p->getThreadNum();
+    Expect_GE(grownNum, 2u);
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(p->getThreadNum() > 1 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    Expect_EQ(p->getThreadNum(), 1u);
+    p->disableElastic();
+
+    // Drain：停止前执行完已投递的任务，之后投递的任务被丢弃
+    cnt = 0;
+    for(int i=0;i<1000;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    p->shutdown(ThreadPool::Drain);
+    Expect_EQ(cnt.load(), 1000);
+    p->addTask([&cnt](){ ++cnt; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Expect_EQ(cnt.load(), 1000);
+    Run_All_TestCase();
+
+    return 0;
+}
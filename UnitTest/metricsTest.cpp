@@ -0,0 +1,94 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(1);
+    p->setPopBatchNum(0);
+
+    // 直方图：bucket[i] 为 [2^(i-1), 2^i) 纳秒，percentile 返回所在区间的上界
+    ThreadPool::Histogram h{};
+    h.bucket[0] = 1;
+    h.bucket[10] = 8;
+    h.bucket[20] = 1;
+    Expect_EQ(h.count(), size_t(10));
+    Expect_EQ(h.percentile(0.05), uint64_t(0));
+    Expect_EQ(h.percentile(0.5), uint64_t(1023));
+    Expect_EQ(h.percentile(1.0), uint64_t((1 << 20) - 1));
+    ThreadPool::Histogram emptyHist{};
+    Expect_EQ(emptyHist.percentile(0.5), uint64_t(0));
+
+    // 默认不统计耗时
+    std::atomic<int> cnt{0};
+    for(int i=0;i<10;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    waitCount(cnt, 10);
+    ThreadPool::Stat s = p->snapshot();
+    Expect_EQ(s.runTime.count(), size_t(0));
+
+    // 开启后记录排队和执行耗时，以及线程忙碌时间
+    p->setTiming(true);
+    cnt = 0;
+    for(int i=0;i<20;++i){
+        p->addTask([&cnt](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            ++cnt;
+        });
+    }
+    waitCount(cnt, 20);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    s = p->snapshot();
+    Expect_EQ(s.runTime.count(), size_t(20));
+    Expect_EQ(s.waitTime.count(), size_t(20));
+    Expect_GE(s.runTime.percentile(0.5), uint64_t(2000000));
+    Expect_GE(s.workers[0].busyNs, uint64_t(40000000));
+    Expect_True(s.workers[0].isRunning);
+    p->setTiming(false);
+
+    // 等待的任务数和历史最大值
+    std::atomic<bool> isStarted{false};
+    std::atomic<bool> isRelease{false};
+    p->addTask([&isStarted, &isRelease](){
+        isStarted = true;
+        while(!isRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(!isStarted.load() && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_True(isStarted.load());
+    cnt = 0;
+    for(int i=0;i<50;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    s = p->snapshot();
+    Expect_EQ(s.taskNum, size_t(50));
+    Expect_GE(s.taskHighWater, size_t(50));
+    isRelease = true;
+    waitCount(cnt, 50);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    s = p->snapshot();
+    Expect_EQ(s.taskNum, size_t(0));
+    Expect_GE(s.taskHighWater, size_t(50));
+    Expect_EQ(s.executedNum, size_t(10 + 20 + 1 + 50));
+    Run_All_TestCase();
+
+    return 0;
+}
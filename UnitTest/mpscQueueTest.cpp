@@ -0,0 +1,117 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+
+#include "unittest.hpp"
+#include "../MessageQueue/mpscQueue.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int ProducerNum = 4;
+constexpr int PerProducerNum = 100000;
+
+int main(){
+    // 单线程：先进先出，空队列 pop 返回 false
+    MpscQueue<int> q;
+    int v = -1;
+    bool isPopped = q.pop(v);
+    Expect_False(isPopped);
+    for(int i=0;i<10;++i){
+        q.push(i);
+    }
+    int inOrder = 0;
+    for(int i=0;i<10;++i){
+        inOrder += q.pop(v) && v == i;
+    }
+    Expect_EQ(inOrder, 10);
+    isPopped = q.pop(v);
+    Expect_False(isPopped);
+
+    // 元素移动进出队列
+    MpscQueue<std::unique_ptr<int>> uq;
+    uq.push(std::make_unique<int>(5));
+    std::unique_ptr<int> out;
+    isPopped = uq.pop(out);
+    Expect_True(isPopped);
+    int outVal = out ? *out : 0;
+    Expect_EQ(outVal, 5);
+
+    // 多个生产者：元素不丢不重，同一生产者的元素保持顺序
+    MpscQueue<std::pair<int, int>> mq;
+    std::vector<std::thread> producers;
+    for(int p=0;p<ProducerNum;++p){
+        producers.emplace_back([p, &mq](){
+            for(int i=0;i<PerProducerNum;++i){
+                mq.emplace(p, i);
+            }
+        });
+    }
+    std::vector<int> next(ProducerNum, 0);
+    int total = 0;
+    int outOfOrder = 0;
+    std::pair<int, int> item;
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while(total < ProducerNum * PerProducerNum && Clock::now() < deadline){
+        if(!mq.pop(item)){
+            std::this_thread::yield();
+            continue;
+        }
+        outOfOrder += item.second != next[item.first];
+        next[item.first] = item.second + 1;
+        ++total;
+    }
+    for(auto& t : producers){
+        t.join();
+    }
+    isPopped = mq.pop(item);
+    Expect_EQ(total, ProducerNum * PerProducerNum);
+    Expect_EQ(outOfOrder, 0);
+    Expect_False(isPopped);
+
+    // 多线程 postMessage，订阅者收到每个线程的消息的顺序与投递顺序一致
+    MessageQueue* mqInst = MessageQueue::getInstance();
+    std::mutex m;
+    std::vector<int> lastSeq(ProducerNum, -1);
+    std::atomic<int> received{0};
+    std::atomic<int> misordered{0};
+    mqInst->registerSubscripter("mpsc/test", [&m, &lastSeq, &received, &misordered](Event e){
+        int p = std::any_cast<int>(e["producer"]);
+        int seq = std::any_cast<int>(e["seq"]);
+        {
+            std::lock_guard<std::mutex> l(m);
+            misordered += seq != lastSeq[p] + 1;
+            lastSeq[p] = seq;
+        }
+        ++received;
+    });
+    producers.clear();
+    for(int p=0;p<ProducerNum;++p){
+        producers.emplace_back([p, mqInst](){
+            for(int i=0;i<10000;++i){
+                Event e("mpsc/test");
+                e["producer"] = p;
+                e["seq"] = i;
+                mqInst->postMessage(std::move(e));
+            }
+        });
+    }
+    for(auto& t : producers){
+        t.join();
+    }
+    deadline = Clock::now() + std::chrono::seconds(10);
+    while(received.load() < ProducerNum * 10000 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_EQ(received.load(), ProducerNum * 10000);
+    Expect_EQ(misordered.load(), 0);
+
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+const MessageQueue::TopicStat* findTopic(const MessageQueue::Stat& s, const std::string& topic){
+    for(auto& t : s.topics){
+        if(t.topic == topic){
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+const MessageQueue::SubscriberStat* findSubscriber(const MessageQueue::Stat& s, int id){
+    for(auto& sub : s.subscribers){
+        if(sub.id == id){
+            return &sub;
+        }
+    }
+    return nullptr;
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // 各 topic 的消息数、各订阅者的调用次数和耗时
+    std::atomic<int> aNum{0};
+    int a1 = mq->subscribe<int>("obs/a", [&aNum](const int&){ ++aNum; });
+    int a2 = mq->subscribe<int>("obs/a", [&aNum](const int&){ ++aNum; });
+    int wild = mq->subscribe<int>("obs/+", [&aNum](const int&){ ++aNum; });
+    for(int i=0;i<100;++i){
+        mq->post("obs/a", i);
+    }
+    waitCount(aNum, 300);
+    MessageQueue::Stat stat = mq->snapshot();
+    const MessageQueue::TopicStat* ta = findTopic(stat, "obs/a");
+    const MessageQueue::SubscriberStat* s1 = findSubscriber(stat, a1);
+    const MessageQueue::SubscriberStat* s2 = findSubscriber(stat, a2);
+    const MessageQueue::SubscriberStat* sw = findSubscriber(stat, wild);
+    Expect_True(ta && s1 && s2 && sw);
+    if(ta && s1 && s2 && sw){
+        Expect_EQ(ta->publishNum, uint64_t(100));
+        Expect_True(ta->mode == MessageQueue::Inline);
+        Expect_EQ(s1->invokeNum, uint64_t(100));
+        Expect_EQ(s2->invokeNum, uint64_t(100));
+        Expect_EQ(s1->runTime.count(), size_t(100));
+        Expect_StrEQ(s1->topic, "obs/a");
+        Expect_StrEQ(sw->topic, "obs/+");
+        Expect_EQ(sw->invokeNum, uint64_t(100));
+    }
+
+    // 没有订阅者的消息计入 unroutedNum
+    uint64_t unrouted = stat.unroutedNum;
+    uint64_t posted = stat.postedNum;
+    std::atomic<int> sentinel{0};
+    mq->subscribe<int>("obs/sentinel", [&sentinel](const int&){ ++sentinel; });
+    for(int i=0;i<5;++i){
+        mq->post("none/obs", i);
+    }
+    mq->post("obs/sentinel", 0);
+    waitCount(sentinel, 1);
+    stat = mq->snapshot();
+    Expect_EQ(stat.unroutedNum - unrouted, uint64_t(5));
+    Expect_EQ(stat.postedNum - posted, uint64_t(6));
+    Expect_EQ(stat.queueDepth, size_t(0));
+
+    // 分发线程被阻塞时，积压的消息数和最早一条的等待时间
+    std::atomic<bool> isRelease{false};
+    std::atomic<int> blockNum{0};
+    mq->subscribe<int>("obs/block", [&isRelease, &blockNum](const int&){
+        while(!isRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ++blockNum;
+    });
+    mq->post("obs/block", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for(int i=0;i<10;++i){
+        mq->post("obs/a", i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    stat = mq->snapshot();
+    isRelease = true;
+    waitCount(blockNum, 1);
+    Expect_GE(stat.queueDepth, size_t(10));
+    Expect_GE(stat.oldestAge.count(), int64_t(std::chrono::nanoseconds(std::chrono::milliseconds(20)).count()));
+
+    // Pooled 方式下订阅者等待处理的消息数
+    mq->setDispatchMode("obs/pooled", MessageQueue::Pooled);
+    std::atomic<bool> isPooledRelease{false};
+    std::atomic<int> pooledNum{0};
+    int pooled = mq->subscribe<int>("obs/pooled", [&isPooledRelease, &pooledNum](const int&){
+        while(!isPooledRelease.load()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ++pooledNum;
+    });
+    for(int i=0;i<5;++i){
+        mq->post("obs/pooled", i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    stat = mq->snapshot();
+    isPooledRelease = true;
+    waitCount(pooledNum, 5);
+    const MessageQueue::SubscriberStat* sp = findSubscriber(stat, pooled);
+    size_t pendingNum = sp ? sp->pendingNum : 0;
+    Expect_EQ(pendingNum, size_t(5));
+    const MessageQueue::TopicStat* tp = findTopic(stat, "obs/pooled");
+    Expect_True(tp && tp->mode == MessageQueue::Pooled);
+
+    // 慢订阅者：耗时不小于阈值时记录编号、topic 和耗时
+    std::mutex m;
+    std::vector<int> slowIDs;
+    std::string slowTopic;
+    std::chrono::nanoseconds slowTime{0};
+    mq->setSlowLog(std::chrono::milliseconds(5), [&m, &slowIDs, &slowTopic, &slowTime](int id, const std::string& topic, std::chrono::nanoseconds time){
+        std::lock_guard<std::mutex> l(m);
+        slowIDs.push_back(id);
+        slowTopic = topic;
+        slowTime = time;
+    });
+    std::atomic<int> slowNum{0};
+    int slow = mq->subscribe<int>("obs/slow", [&slowNum](const int&){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ++slowNum;
+    });
+    mq->subscribe<int>("obs/slow", [&slowNum](const int&){ ++slowNum; });
+    mq->post("obs/slow", 0);
+    waitCount(slowNum, 2);
+    {
+        std::lock_guard<std::mutex> l(m);
+        Expect_EQ(slowIDs.size(), size_t(1));
+        Expect_EQ(slowIDs.empty() ? -1 : slowIDs[0], slow);
+        Expect_StrEQ(slowTopic, "obs/slow");
+        Expect_GE(slowTime.count(), int64_t(std::chrono::nanoseconds(std::chrono::milliseconds(5)).count()));
+    }
+
+    // 关闭计时后不再统计耗时，也不再记录慢订阅者，调用次数照常统计
+    mq->setTiming(false);
+    mq->post("obs/slow", 1);
+    waitCount(slowNum, 4);
+    stat = mq->snapshot();
+    const MessageQueue::SubscriberStat* ss = findSubscriber(stat, slow);
+    uint64_t slowInvokeNum = ss ? ss->invokeNum : 0;
+    size_t slowTimedNum = ss ? ss->runTime.count() : 0;
+    Expect_EQ(slowInvokeNum, uint64_t(2));
+    Expect_EQ(slowTimedNum, size_t(1));
+    {
+        std::lock_guard<std::mutex> l(m);
+        Expect_EQ(slowIDs.size(), size_t(1));
+    }
+    mq->setTiming(true);
+    mq->setSlowLog(std::chrono::nanoseconds(0));
+    Run_All_TestCase();
+
+    return 0;
+}
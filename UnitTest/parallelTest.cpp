@@ -0,0 +1,84 @@
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+#include "unittest.hpp"
+#include "../ThreadPool/parallel.hpp"
+using namespace shochu;
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(4);
+
+    // parallelFor 每个下标恰好执行一次
+    std::vector<int> hit(100000, 0);
+    parallelFor(size_t(0), hit.size(), [&hit](size_t i){ ++hit[i]; });
+    Expect_EQ(size_t(std::count(hit.begin(), hit.end(), 1)), hit.size());
+
+    // 空区间和指定 grain
+    int called = 0;
+    parallelFor(5, 5, [&called](int){ ++called; });
+    Expect_EQ(called, 0);
+    std::atomic<int> sum{0};
+    parallelFor(0, 1000, [&sum](int i){ sum += i; }, 7);
+    Expect_EQ(sum.load(), 999 * 1000 / 2);
+
+    // parallelTransformReduce 与 std::transform_reduce 结果相同
+    std::vector<int> v(1000000);
+    std::iota(v.begin(), v.end(), 0);
+    long total = parallelTransformReduce(v.begin(), v.end(), 0L, std::plus<>(), [](int x){ return long(x); });
+    Expect_EQ(total, std::transform_reduce(v.begin(), v.end(), 0L, std::plus<>(), [](int x){ return long(x); }));
+    std::vector<int> empty;
+    long emptyTotal = parallelTransformReduce(empty.begin(), empty.end(), 42L, std::plus<>(), [](int x){ return long(x); });
+    Expect_EQ(emptyTotal, 42L);
+
+    // parallelSort 与 std::sort 结果相同，支持自定义比较
+    std::mt19937 rng(1);
+    std::vector<int> a(300000);
+    for(auto& x : a){
+        x = int(rng() % 100000);
+    }
+    std::vector<int> b = a;
+    parallelSort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    Expect_True(a == b);
+    parallelSort(a.begin(), a.end(), std::greater<>());
+    Expect_True(std::is_sorted(a.begin(), a.end(), std::greater<>()));
+
+    // parallelScan 为包含当前元素的前缀和
+    std::vector<long> in(100001, 1);
+    std::vector<long> out(in.size());
+    parallelScan(in.begin(), in.end(), out.begin());
+    std::vector<long> expect(in.size());
+    std::inclusive_scan(in.begin(), in.end(), expect.begin());
+    Expect_True(out == expect);
+
+    // 子任务抛出的异常在调用线程重新抛出
+    std::string what;
+    try{
+        parallelFor(0, 1000, [](int i){
+            if(i == 500){
+                throw std::runtime_error("at 500");
+            }
+        }, 10);
+    }
+    catch(const std::runtime_error& e){
+        what = e.what();
+    }
+    Expect_StrEQ(what, "at 500");
+
+    // 在任务内部嵌套调用，等待时执行其他任务，不会占满线程死锁
+    std::atomic<int> nested{0};
+    parallelFor(0, 16, [&nested](int){
+        parallelFor(0, 100, [&nested](int){ ++nested; }, 1);
+    }, 1);
+    Expect_EQ(nested.load(), 1600);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 占住唯一的工作线程，之后投递的任务都在公共队列中排队
+class Gate{
+public:
+    explicit Gate(ThreadPool* p) : isStarted(false), isRelease(false){
+        p->addTask([this](){
+            this->isStarted = true;
+            while(!this->isRelease.load()){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while(!this->isStarted.load() && Clock::now() < deadline){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Expect_True(this->isStarted.load());
+    }
+    void release(){
+        this->isRelease = true;
+    }
+
+private:
+    std::atomic<bool> isStarted;
+    std::atomic<bool> isRelease;
+};
+
+// 按执行顺序记录任务名
+std::mutex orderMutex;
+std::string order;
+
+void record(char c){
+    std::lock_guard<std::mutex> l(orderMutex);
+    order += c;
+}
+
+void waitOrder(size_t n){
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(Clock::now() < deadline){
+        {
+            std::lock_guard<std::mutex> l(orderMutex);
+            if(order.size() >= n){
+                return;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+std::string takeOrder(){
+    std::lock_guard<std::mutex> l(orderMutex);
+    std::string s;
+    s.swap(order);
+    return s;
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(1);
+
+    // 高优先级先执行，同一优先级按投递顺序
+    {
+        Gate g(p);
+        p->addTask(ThreadPool::Low, [](){ record('l'); });
+        p->addTask(ThreadPool::Normal, [](){ record('n'); });
+        p->addTask(ThreadPool::High, [](){ record('h'); });
+        p->addTask(ThreadPool::Normal, [](){ record('m'); });
+        p->addTask(ThreadPool::High, [](){ record('i'); });
+        g.release();
+    }
+    waitOrder(5);
+    Expect_StrEQ(takeOrder(), "hinml");
+
+    // 等待超过 agingTime 的低优先级任务提到最前
+    p->setAgingTime(std::chrono::milliseconds(20));
+    {
+        Gate g(p);
+        p->addTask(ThreadPool::Low, [](){ record('l'); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        p->addTask(ThreadPool::High, [](){ record('h'); });
+        g.release();
+    }
+    waitOrder(2);
+    Expect_StrEQ(takeOrder(), "lh");
+    p->setAgingTime(std::chrono::milliseconds(100));
+
+    // 过了截止时间还没开始的任务被丢弃
+    ThreadPool::TaskOption option;
+    option.deadline = Clock::now() + std::chrono::milliseconds(10);
+    {
+        Gate g(p);
+        p->addTask(option, [](){ record('x'); });
+        p->addTask([](){ record('n'); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        g.release();
+    }
+    waitOrder(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_StrEQ(takeOrder(), "n");
+    Expect_EQ(p->getExpiredNum(), size_t(1));
+
+    // 不丢弃时过期任务照常执行
+    p->setDropExpired(false);
+    option.deadline = Clock::now() + std::chrono::milliseconds(10);
+    {
+        Gate g(p);
+        p->addTask(option, [](){ record('x'); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        g.release();
+    }
+    waitOrder(1);
+    Expect_StrEQ(takeOrder(), "x");
+    Expect_EQ(p->getExpiredNum(), size_t(1));
+    Run_All_TestCase();
+
+    return 0;
+}
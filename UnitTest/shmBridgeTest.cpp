@@ -0,0 +1,138 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "unittest.hpp"
+#include "../MessageQueue/shmBridge.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int SampleNum = 5000;
+
+struct Sample{
+    uint64_t id;
+    double value;
+};
+
+// 子进程回报的结果，kind 为0时表示已经连接
+struct Ack{
+    int kind;
+    int count;
+    int misorder;
+    int other;
+    uint64_t dropped;
+};
+
+struct Huge{
+    char data[1024];
+};
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 子进程：收取父进程投递的消息，检查顺序后回报
+int child(const std::string& name){
+    MessageQueue* mq = MessageQueue::getInstance();
+    ShmBridge bridge(name);
+    bridge.mirror<Sample>("shm/sample");
+    bridge.mirror<Ack>("shm/ack");
+    std::atomic<int> count{0};
+    std::atomic<int> misorder{0};
+    std::atomic<int> other{0};
+    mq->subscribe<Sample>("shm/sample", [&count, &misorder](const Sample& s){
+        misorder += s.id != uint64_t(count.load()) || s.value != s.id * 0.5;
+        ++count;
+    });
+    mq->subscribe<int>("shm/other", [&other](const int&){ ++other; });
+
+    // 父进程收到之前不断发送，父进程的桥可能还没有打开
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(count.load() == 0 && Clock::now() < deadline){
+        mq->post("shm/ack", Ack{0, 0, 0, 0, 0});
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    waitCount(count, SampleNum);
+    mq->post("shm/ack", Ack{1, count.load(), misorder.load(), other.load(), bridge.getDroppedNum()});
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    return count.load() == SampleNum && misorder.load() == 0 ? 0 : 1;
+}
+
+int main(){
+    std::string name = "/shochu-shmBridgeTest-" + std::to_string(::getpid());
+    ShmBridge::unlink(name);
+    // 在创建任何线程之前 fork
+    pid_t pid = ::fork();
+    if(pid == 0){
+        ::_exit(child(name));
+    }
+
+    MessageQueue* mq = MessageQueue::getInstance();
+    ShmBridge bridge(name);
+    bridge.mirror<Sample>("shm/sample");
+    bridge.mirror<Ack>("shm/ack");
+    std::atomic<int> readyNum{0};
+    std::atomic<int> doneNum{0};
+    Ack result{};
+    mq->subscribe<Ack>("shm/ack", [&readyNum, &doneNum, &result](const Ack& a){
+        if(a.kind == 0){
+            ++readyNum;
+        }
+        else{
+            result = a;
+            ++doneNum;
+        }
+    });
+    std::atomic<int> localNum{0};
+    mq->subscribe<Sample>("shm/sample", [&localNum](const Sample&){ ++localNum; });
+
+    // 子进程 -> 父进程
+    waitCount(readyNum, 1);
+    Expect_GE(readyNum.load(), 1);
+
+    // 父进程 -> 子进程：按投递顺序全部送达，没有 mirror 的 topic 不转发
+    mq->post("shm/other", 1);
+    for(int i=0;i<SampleNum;++i){
+        mq->post("shm/sample", Sample{uint64_t(i), i * 0.5});
+    }
+    waitCount(doneNum, 1);
+    Expect_EQ(doneNum.load(), 1);
+    Expect_EQ(result.count, SampleNum);
+    Expect_EQ(result.misorder, 0);
+    Expect_EQ(result.other, 0);
+    Expect_EQ(result.dropped, uint64_t(0));
+
+    // 收到的消息不再转发，本进程的订阅者只收到自己投递的一份
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Expect_EQ(localNum.load(), SampleNum);
+    Expect_EQ(bridge.getDroppedNum(), uint64_t(0));
+
+    int status = -1;
+    ::waitpid(pid, &status, 0);
+    Expect_True(WIFEXITED(status));
+    int exitCode = WEXITSTATUS(status);
+    Expect_EQ(exitCode, 0);
+
+    // 负载超过槽位大小时抛出 std::invalid_argument
+    bool isThrown = false;
+    try{
+        bridge.mirror<Huge>("shm/huge");
+    }
+    catch(const std::invalid_argument&){
+        isThrown = true;
+    }
+    Expect_True(isThrown);
+    Run_All_TestCase();
+
+    ShmBridge::unlink(name);
+    return 0;
+}
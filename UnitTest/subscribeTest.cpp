@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // 投递的同时其他线程不断订阅和取消订阅，一直存在的订阅者收到全部消息
+    std::atomic<int> stable{0};
+    std::atomic<int> churned{0};
+    mq->subscribe<int>("sub/churn", [&stable](const int&){ ++stable; });
+    std::atomic<bool> isStop{false};
+    std::vector<std::thread> churners;
+    for(int t=0;t<2;++t){
+        churners.emplace_back([mq, &isStop, &churned](){
+            while(!isStop.load()){
+                int id = mq->subscribe<int>("sub/churn", [&churned](const int&){ ++churned; });
+                std::this_thread::yield();
+                mq->unregisterSubscripter(id);
+            }
+        });
+    }
+    std::thread producer([mq](){
+        for(int i=0;i<50000;++i){
+            mq->post("sub/churn", i);
+        }
+    });
+    producer.join();
+    waitCount(stable, 50000);
+    isStop = true;
+    for(auto& t : churners){
+        t.join();
+    }
+    Expect_EQ(stable.load(), 50000);
+
+    // 取消订阅之后投递的消息不再送达
+    std::atomic<int> removed{0};
+    std::atomic<int> sentinel{0};
+    int id = mq->subscribe<int>("sub/removed", [&removed](const int&){ ++removed; });
+    mq->subscribe<int>("sub/removed", [&sentinel](const int&){ ++sentinel; });
+    mq->post("sub/removed", 1);
+    waitCount(sentinel, 1);
+    mq->unregisterSubscripter(id);
+    mq->post("sub/removed", 2);
+    waitCount(sentinel, 2);
+    Expect_EQ(removed.load(), 1);
+    Expect_EQ(sentinel.load(), 2);
+    // 重复取消或取消不存在的编号没有影响
+    mq->unregisterSubscripter(id);
+    mq->unregisterSubscripter(-1);
+
+    // 在订阅者中取消自己、订阅其他 topic，不会死锁
+    std::atomic<int> selfNum{0};
+    std::atomic<int> lateNum{0};
+    std::atomic<int> selfID{-1};
+    selfID = mq->subscribe<int>("sub/self", [mq, &selfNum, &selfID, &lateNum](const int&){
+        ++selfNum;
+        mq->unregisterSubscripter(selfID.load());
+        mq->subscribe<int>("sub/late", [&lateNum](const int&){ ++lateNum; });
+    });
+    mq->post("sub/self", 1);
+    waitCount(selfNum, 1);
+    mq->post("sub/self", 2);
+    mq->post("sub/late", 1);
+    waitCount(lateNum, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(selfNum.load(), 1);
+    Expect_EQ(lateNum.load(), 1);
+    Run_All_TestCase();
+
+    return 0;
+}
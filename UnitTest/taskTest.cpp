@@ -0,0 +1,99 @@
+#include <new>
+#include <memory>
+#include <cstdlib>
+#include <utility>
+
+#include "unittest.hpp"
+#include "../ThreadPool/task.hpp"
+using namespace shochu;
+
+// 统计申请内存的次数，Expect_* 本身也会申请内存，只在统计区间外调用
+size_t allocNum = 0;
+
+__attribute__((noinline)) void* operator new(size_t size){
+    ++allocNum;
+    if(void* p = std::malloc(size ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept{
+    std::free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept{
+    std::free(p);
+}
+
+// 记录析构次数
+struct Counter{
+    explicit Counter(int* n) : n(n){}
+    Counter(Counter&& o) noexcept : n(std::exchange(o.n, nullptr)){}
+    ~Counter(){
+        if(this->n){
+            ++*this->n;
+        }
+    }
+    int* n;
+};
+
+int main(){
+    // 较小的可调用对象和参数存放在 Task 内部，构造、移动、执行都不申请内存
+    int sum = 0;
+    bool isMovedEmpty = false;
+    bool isValid = false;
+    size_t before = allocNum;
+    {
+        Task t([&sum](int a, int b){ sum = a + b; }, 1, 2);
+        Task u(std::move(t));
+        Task w;
+        w = std::move(u);
+        w();
+        isMovedEmpty = !t && !u;
+        isValid = bool(w);
+    }
+    size_t smallAllocNum = allocNum - before;
+    Expect_True(isMovedEmpty);
+    Expect_True(isValid);
+    Expect_EQ(smallAllocNum, size_t(0));
+    Expect_EQ(sum, 3);
+
+    // 超过缓冲区时只申请一次，移动时不再申请
+    char big[Task::BufferSize * 2] = {1};
+    char got = 0;
+    before = allocNum;
+    {
+        Task t([big, &got](){ got = big[0]; });
+        Task u(std::move(t));
+        u();
+    }
+    size_t bigAllocNum = allocNum - before;
+    Expect_EQ(bigAllocNum, size_t(1));
+    Expect_EQ(got, char(1));
+
+    // 只能移动的可调用对象和参数，绑定的参数移动给可调用对象
+    std::unique_ptr<int> p(new int(7));
+    int val = 0;
+    {
+        Task t([&val](std::unique_ptr<int> q){ val = *q; }, std::move(p));
+        Task u(std::move(t));
+        u();
+    }
+    Expect_EQ(val, 7);
+
+    // 捕获的对象无论是否执行都只析构一次
+    int destroyNum = 0;
+    {
+        Task t([c = Counter(&destroyNum)](){});
+        Task u(std::move(t));
+        u();
+    }
+    {
+        Task t([c = Counter(&destroyNum)](){});
+        t.reset();
+        t.reset();
+    }
+    Expect_EQ(destroyNum, 2);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+
+    // 到期后执行，不会提前
+    std::atomic<long> elapsedMs{-1};
+    auto begin = Clock::now();
+    TimerHandle h = p->scheduleAfter(std::chrono::milliseconds(30), [&elapsedMs, begin](){
+        elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+    });
+    Expect_True(h.valid());
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(elapsedMs.load() < 0 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Expect_GE(elapsedMs.load(), 30L);
+    Expect_LT(elapsedMs.load(), 500L);
+
+    // 到期前取消的不再执行
+    std::atomic<int> cancelledRun{0};
+    h = p->scheduleAfter(std::chrono::milliseconds(20), [&cancelledRun](){ ++cancelledRun; });
+    h.cancel();
+    Expect_True(h.isCancelled());
+
+    // 周期任务反复执行，取消后停止
+    std::atomic<int> tick{0};
+    TimerHandle every = p->scheduleEvery(std::chrono::milliseconds(10), [&tick](){ ++tick; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    every.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    int tickNum = tick.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Expect_GE(tickNum, 5);
+    Expect_EQ(tick.load(), tickNum);
+    Expect_EQ(cancelledRun.load(), 0);
+
+    // 大量取消的远期定时器会被回收，不会一直留到到期
+    std::atomic<int> fired{0};
+    TimerWheel wheel([&fired](Task&& t){
+        t();
+        ++fired;
+    });
+    std::vector<TimerHandle> hs;
+    for(int i=0;i<1000;++i){
+        hs.push_back(wheel.after(std::chrono::hours(1), [](){}));
+    }
+    Expect_EQ(wheel.size(), size_t(1000));
+    for(auto& t : hs){
+        t.cancel();
+    }
+    // 再加一个近期的定时器让内部线程醒来清理
+    wheel.after(std::chrono::milliseconds(5), [](){});
+    deadline = Clock::now() + std::chrono::seconds(2);
+    while(wheel.size() > 0 && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    Expect_EQ(wheel.size(), size_t(0));
+    Expect_EQ(fired.load(), 1);
+
+    // 停止后返回无效的句柄
+    wheel.stop();
+    TimerHandle stopped = wheel.after(std::chrono::milliseconds(1), [](){});
+    Expect_False(stopped.valid());
+    p->shutdown();
+    stopped = p->scheduleAfter(std::chrono::milliseconds(1), [](){});
+    Expect_False(stopped.valid());
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int TopicNum = 5000;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // 同一名称总是同一编号，编号可以查回名称
+    TopicID a = internTopic("route/a");
+    TopicID b = internTopic("route/b");
+    Expect_EQ(internTopic("route/a"), a);
+    Expect_NE(a, b);
+    Expect_StrEQ(topicName(a), "route/a");
+    Expect_StrEQ(Event(b).topic(), "route/b");
+    Expect_EQ(Event("route/a").topicID(), a);
+
+    // 多个线程同时分配编号，结果一致
+    std::vector<std::vector<TopicID>> ids(4);
+    std::vector<std::thread> threads;
+    for(int t=0;t<4;++t){
+        threads.emplace_back([t, &ids](){
+            for(int i=0;i<1000;++i){
+                ids[t].push_back(internTopic("route/concurrent/" + std::to_string(i)));
+            }
+        });
+    }
+    for(auto& t : threads){
+        t.join();
+    }
+    int sameNum = 0;
+    for(int i=0;i<1000;++i){
+        sameNum += ids[0][i] == ids[1][i] && ids[1][i] == ids[2][i] && ids[2][i] == ids[3][i];
+    }
+    Expect_EQ(sameNum, 1000);
+
+    // 按名称订阅、按编号投递，以及反过来
+    std::atomic<int> byName{0};
+    std::atomic<int> byID{0};
+    mq->registerSubscripter("route/a", [&byName](Event){ ++byName; });
+    mq->registerSubscripter(b, [&byID](Event){ ++byID; });
+    mq->postMessage(Event(a));
+    mq->postMessage(Event("route/b"));
+    waitCount(byName, 1);
+    waitCount(byID, 1);
+    Expect_EQ(byName.load(), 1);
+    Expect_EQ(byID.load(), 1);
+
+    // 大量 topic 各自只路由到自己的订阅者
+    std::vector<std::atomic<int>> hit(TopicNum);
+    std::atomic<int> total{0};
+    for(int i=0;i<TopicNum;++i){
+        mq->subscribe<int>("route/many/" + std::to_string(i), [i, &hit, &total](const int& v){
+            hit[i] += v == i;
+            ++total;
+        });
+    }
+    for(int i=0;i<TopicNum;++i){
+        mq->post(internTopic("route/many/" + std::to_string(i)), i);
+    }
+    waitCount(total, TopicNum);
+    int correct = 0;
+    for(auto& h : hit){
+        correct += h.load() == 1;
+    }
+    Expect_EQ(total.load(), TopicNum);
+    Expect_EQ(correct, TopicNum);
+
+    // 取消订阅后不再收到
+    int id = mq->registerSubscripter("route/c", [&byName](Event){ ++byName; });
+    mq->unregisterSubscripter(id);
+    mq->postMessage(Event("route/c"));
+    mq->postMessage(Event("route/a"));
+    waitCount(byName, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(byName.load(), 2);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include <span>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 记录复制次数
+struct Payload{
+    static std::atomic<int> copyNum;
+
+    Payload() = default;
+    explicit Payload(int v) : v(v){}
+    Payload(const Payload& o) : v(o.v){
+        ++copyNum;
+    }
+    Payload(Payload&&) = default;
+    Payload& operator=(const Payload& o){
+        this->v = o.v;
+        ++copyNum;
+        return *this;
+    }
+    Payload& operator=(Payload&&) = default;
+
+    int v = 0;
+};
+std::atomic<int> Payload::copyNum{0};
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+constexpr int JoinProducerNum = 2;
+constexpr int JoinPerProducerNum = 100000;
+
+// 中途加入通道的订阅者，按生产者检查收到的值是否连续
+struct LateConsumer{
+    int next[JoinProducerNum];
+    std::atomic<int> misorderNum{0};
+    std::atomic<int> doneNum{0};
+
+    LateConsumer(){
+        for(int& n : this->next){
+            n = -1;
+        }
+    }
+    void onBatch(std::span<const int> batch){
+        for(int v : batch){
+            int p = v / JoinPerProducerNum;
+            int i = v % JoinPerProducerNum;
+            // 第一条可以从任意位置开始，之后必须连续
+            if(this->next[p] >= 0 && i != this->next[p]){
+                ++this->misorderNum;
+            }
+            this->next[p] = i + 1;
+            if(i == JoinPerProducerNum - 1){
+                ++this->doneNum;
+            }
+        }
+    }
+};
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // 订阅者只收到自己类型的负载，分发给多个订阅者时不复制
+    std::atomic<int> payloadNum{0};
+    std::atomic<int> payloadSum{0};
+    std::atomic<int> stringNum{0};
+    for(int i=0;i<3;++i){
+        mq->subscribe<Payload>("typed/a", [&payloadNum, &payloadSum](const Payload& p){
+            payloadSum += p.v;
+            ++payloadNum;
+        });
+    }
+    mq->subscribe<std::string>("typed/a", [&stringNum](const std::string&){ ++stringNum; });
+    mq->post("typed/a", Payload(7));
+    mq->post("typed/a", std::string("text"));
+    waitCount(payloadNum, 3);
+    waitCount(stringNum, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(payloadNum.load(), 3);
+    Expect_EQ(payloadSum.load(), 21);
+    Expect_EQ(stringNum.load(), 1);
+    Expect_EQ(Payload::copyNum.load(), 0);
+
+    // postMessage 投递的消息负载类型为 Event，两种订阅方式都能收到
+    std::atomic<int> eventNum{0};
+    std::atomic<int> legacyNum{0};
+    mq->subscribe<Event>("typed/event", [&eventNum](const Event& e){
+        eventNum += std::any_cast<int>(*e.find("k"));
+    });
+    mq->registerSubscripter("typed/event", [&legacyNum](Event e){
+        legacyNum += std::any_cast<int>(e["k"]);
+    });
+    Event e("typed/event");
+    e["k"] = 5;
+    mq->postMessage(e);
+    waitCount(eventNum, 5);
+    waitCount(legacyNum, 5);
+    Expect_EQ(eventNum.load(), 5);
+    Expect_EQ(legacyNum.load(), 5);
+
+    // 通道：每个订阅者按顺序收到全部消息，单条和批量发布
+    Channel<int>& ch = mq->openChannel<int>("typed/channel", 64);
+    Expect_EQ(ch.capacity(), size_t(64));
+    Expect_True(&mq->openChannel<int>("typed/channel") == &ch);
+    std::atomic<int> c1{0};
+    std::atomic<int> c2{0};
+    std::atomic<int> misorderNum{0};
+    int next1 = 0;
+    int next2 = 0;
+    ch.subscribe([&c1, &next1, &misorderNum](std::span<const int> batch){
+        for(int v : batch){
+            misorderNum += v != next1++;
+        }
+        c1 += int(batch.size());
+    });
+    ch.subscribe([&c2, &next2, &misorderNum](std::span<const int> batch){
+        for(int v : batch){
+            misorderNum += v != next2++;
+        }
+        c2 += int(batch.size());
+    });
+    for(int i=0;i<1000;++i){
+        ch.publish(i);
+    }
+    std::vector<int> bulk;
+    for(int i=1000;i<5000;++i){
+        bulk.push_back(i);
+    }
+    ch.publish(bulk.begin(), bulk.end());
+    waitCount(c1, 5000);
+    waitCount(c2, 5000);
+    Expect_EQ(c1.load(), 5000);
+    Expect_EQ(c2.load(), 5000);
+    Expect_EQ(misorderNum.load(), 0);
+
+    // 同一 topic 以其他类型打开时抛出 std::invalid_argument
+    bool isThrown = false;
+    try{
+        mq->openChannel<double>("typed/channel");
+    }
+    catch(const std::invalid_argument&){
+        isThrown = true;
+    }
+    Expect_True(isThrown);
+
+    // 超过 MaxConsumerNum 个订阅者时抛出 std::length_error
+    Channel<int>& full = mq->openChannel<int>("typed/full", 16);
+    isThrown = false;
+    try{
+        for(size_t i=0;i<=Channel<int>::MaxConsumerNum;++i){
+            full.subscribe([](std::span<const int>){});
+        }
+    }
+    catch(const std::length_error&){
+        isThrown = true;
+    }
+    Expect_True(isThrown);
+
+    // 多个生产者发布期间不断有订阅者加入，新订阅者没有读过的槽位不会被覆盖
+    Channel<int>& join = mq->openChannel<int>("typed/join", 16);
+    std::vector<std::unique_ptr<LateConsumer>> lates;
+    lates.push_back(std::make_unique<LateConsumer>());
+    join.subscribe([c = lates.back().get()](std::span<const int> batch){ c->onBatch(batch); });
+    std::vector<std::thread> producers;
+    for(int p=0;p<JoinProducerNum;++p){
+        producers.emplace_back([&join, p](){
+            for(int i=0;i<JoinPerProducerNum;++i){
+                join.publish(p * JoinPerProducerNum + i);
+            }
+        });
+    }
+    for(int i=0;i<8;++i){
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        lates.push_back(std::make_unique<LateConsumer>());
+        join.subscribe([c = lates.back().get()](std::span<const int> batch){ c->onBatch(batch); });
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(20);
+    bool isAllDone = false;
+    while(!isAllDone && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        isAllDone = true;
+        for(auto& c : lates){
+            isAllDone = isAllDone && c->doneNum.load() == JoinProducerNum;
+        }
+    }
+    int joinMisorderNum = 0;
+    for(auto& c : lates){
+        joinMisorderNum += c->misorderNum.load();
+    }
+    Expect_True(isAllDone);
+    Expect_EQ(joinMisorderNum, 0);
+    if(!isAllDone){
+        // 槽位被覆盖时订阅者和生产者互相等待，通道无法析构，报告后直接退出
+        Run_All_TestCase();
+        std::_Exit(1);
+    }
+    for(auto& t : producers){
+        t.join();
+    }
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 进程已使用的 CPU 时间（毫秒）
+long cpuMs(){
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1000 + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1000;
+}
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(4);
+
+    // 先让所有线程启动后进入休眠
+    std::atomic<int> cnt{0};
+    p->addTask([&cnt](){ ++cnt; });
+    waitCount(cnt, 1);
+    Expect_EQ(cnt.load(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // 没有任务时线程休眠，不再定时轮询
+    long before = cpuMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long idleCpu = cpuMs() - before;
+    Expect_LT(idleCpu, 50L);
+
+    // 休眠中的线程在投递后立即被唤醒
+    // 超时未执行的任务计入 missNum，任务可能在之后才执行，latencyUs 放在循环外
+    long maxLatencyUs = 0;
+    int missNum = 0;
+    std::atomic<long> latencyUs{-1};
+    for(int i=0;i<20 && missNum==0;++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        latencyUs = -1;
+        auto postTime = Clock::now();
+        p->addTask([&latencyUs, postTime](){
+            latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - postTime).count();
+        });
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while(latencyUs.load() < 0 && Clock::now() < deadline){
+            std::this_thread::yield();
+        }
+        missNum += latencyUs.load() < 0;
+        maxLatencyUs = std::max(maxLatencyUs, latencyUs.load());
+    }
+    Expect_EQ(missNum, 0);
+    Expect_LT(maxLatencyUs, 20000L);
+
+    // 关闭自旋后同样能被唤醒
+    p->setSpinNum(0);
+    cnt = 0;
+    for(int i=0;i<1000;++i){
+        p->addTask([&cnt](){ ++cnt; });
+    }
+    waitCount(cnt, 1000);
+    Expect_EQ(cnt.load(), 1000);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include "unittest.hpp"
+#include "../MessageQueue/messageQueue.h"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+void waitCount(std::atomic<int>& cnt, int n){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(cnt.load() < n && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(){
+    MessageQueue* mq = MessageQueue::getInstance();
+
+    // + 匹配一级，# 匹配其后任意多级，包括零级
+    std::atomic<int> plusNum{0};
+    std::atomic<int> hashNum{0};
+    std::atomic<int> exactNum{0};
+    std::atomic<int> sentinel{0};
+    mq->subscribe<int>("sensor/+/temp", [&plusNum](const int& v){ plusNum += v; });
+    mq->subscribe<int>("sensor/#", [&hashNum](const int& v){ hashNum += v; });
+    mq->subscribe<int>("sensor/a/temp", [&exactNum](const int& v){ exactNum += v; });
+    mq->subscribe<int>("wild/sentinel", [&sentinel](const int&){ ++sentinel; });
+    mq->post("sensor/a/temp", 1);
+    mq->post("sensor/b/temp", 10);
+    mq->post("sensor/a/humid", 100);
+    mq->post("sensor/a/b/temp", 1000);
+    mq->post("sensor", 10000);
+    mq->post("other/a/temp", 100000);
+    mq->post("wild/sentinel", 0);
+    waitCount(sentinel, 1);
+    waitCount(hashNum, 11111);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(plusNum.load(), 11);
+    Expect_EQ(hashNum.load(), 11111);
+    Expect_EQ(exactNum.load(), 1);
+
+    // 分发过的 topic 在订阅变化后重新匹配
+    std::atomic<int> lateNum{0};
+    int lateID = mq->subscribe<int>("sensor/a/+", [&lateNum](const int& v){ lateNum += v; });
+    mq->post("sensor/a/temp", 1);
+    mq->post("sensor/a/humid", 2);
+    waitCount(lateNum, 3);
+    Expect_EQ(lateNum.load(), 3);
+
+    // 取消通配订阅后不再收到
+    mq->unregisterSubscripter(lateID);
+    mq->post("sensor/a/temp", 4);
+    waitCount(exactNum, 6);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Expect_EQ(lateNum.load(), 3);
+    Expect_EQ(exactNum.load(), 6);
+
+    // 匹配多个 topic 时不会被并发调用，消息按投递顺序到达
+    std::atomic<int> inside{0};
+    std::atomic<int> overlapNum{0};
+    std::atomic<int> multiNum{0};
+    std::atomic<int> misorderNum{0};
+    int last = -1;
+    mq->subscribe<int>("multi/#", [&inside, &overlapNum, &multiNum, &misorderNum, &last](const int& v){
+        if(inside.fetch_add(1) != 0){
+            ++overlapNum;
+        }
+        misorderNum += v != last + 1;
+        last = v;
+        inside.fetch_sub(1);
+        ++multiNum;
+    });
+    for(int i=0;i<4;++i){
+        mq->setDispatchMode("multi/" + std::to_string(i), MessageQueue::Pooled);
+    }
+    for(int i=0;i<4000;++i){
+        mq->post("multi/" + std::to_string(i % 4), i);
+    }
+    waitCount(multiNum, 4000);
+    Expect_EQ(multiNum.load(), 4000);
+    Expect_EQ(overlapNum.load(), 0);
+    Expect_EQ(misorderNum.load(), 0);
+
+    // Event 订阅同样支持通配
+    std::atomic<int> eventNum{0};
+    mq->registerSubscripter("legacy/+", [&eventNum](Event){ ++eventNum; });
+    mq->postMessage(Event("legacy/x"));
+    mq->postMessage(Event("legacy/y"));
+    waitCount(eventNum, 2);
+    Expect_EQ(eventNum.load(), 2);
+
+    // + 和 # 没有单独占一级，或者 # 不在最后一级时抛出 std::invalid_argument
+    int errorNum = 0;
+    for(const char* pattern : {"sensor/a+", "sensor/#/temp", "sensor/te#", "+a/b"}){
+        try{
+            mq->subscribe<int>(pattern, [](const int&){});
+        }
+        catch(const std::invalid_argument&){
+            ++errorNum;
+        }
+    }
+    Expect_EQ(errorNum, 4);
+    Run_All_TestCase();
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "unittest.hpp"
+#include "../ThreadPool/threadPool.hpp"
+using namespace shochu;
+
+using Clock = std::chrono::steady_clock;
+
+// 最多等待10秒，返回条件是否满足，回归时测试失败而不是一直挂起
+template<typename F>
+bool waitUntil(F&& isReady){
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(!isReady() && Clock::now() < deadline){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return isReady();
+}
+
+int main(){
+    ThreadPool* p = ThreadPool::getInstance();
+    p->setThreadNum(4);
+
+    // 外部线程投递的任务和任务中再投递的任务都会执行
+    std::atomic<int> cnt{0};
+    for(int i=0;i<10000;++i){
+        p->addTask([p, &cnt](int x){
+            ++cnt;
+            if(x % 10 == 0){
+                p->addTask([&cnt](){ ++cnt; });
+            }
+        }, i);
+    }
+    waitUntil([&cnt](){ return cnt.load() >= 11000; });
+    Expect_EQ(cnt.load(), 11000);
+
+    // 任务中投递的子任务进入本线程队列，投递者一直等待时只能被其他线程窃取执行
+    size_t stolenBefore = p->snapshot().stolenNum;
+    std::atomic<int> childNum{0};
+    std::atomic<bool> isDone{false};
+    p->addTask([p, &childNum, &isDone](){
+        for(int i=0;i<100;++i){
+            p->addTask([&childNum](){ ++childNum; });
+        }
+        waitUntil([&childNum](){ return childNum.load() >= 100; });
+        isDone = true;
+    });
+    bool isParentDone = waitUntil([&isDone](){ return isDone.load(); });
+    Expect_True(isParentDone);
+    Expect_EQ(childNum.load(), 100);
+    Expect_GE(p->snapshot().stolenNum - stolenBefore, size_t(100));
+
+    // 每个工作线程的统计之和等于总数，计数在任务返回后才增加
+    waitUntil([p](){ return p->snapshot().executedNum >= 11000 + 101; });
+    ThreadPool::Stat s = p->snapshot();
+    size_t executedNum = 0;
+    size_t stolenNum = 0;
+    for(auto& w : s.workers){
+        executedNum += w.executedNum;
+        stolenNum += w.stolenNum;
+    }
+    Expect_EQ(executedNum, s.executedNum);
+    Expect_EQ(stolenNum, s.stolenNum);
+    Expect_EQ(s.executedNum, size_t(11000 + 101));
+    Run_All_TestCase();
+
+    return 0;
+}